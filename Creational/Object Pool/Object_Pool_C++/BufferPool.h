@@ -0,0 +1,228 @@
+
+//************************************************************************/
+//* BufferPool.h                                                         */
+//************************************************************************/
+
+// Object Pool for variable-size byte buffers.
+
+// The pools in ObjectPool.h reuse objects of one type. Buffers, however, are asked for in all sizes,
+// so BufferPool keeps one pool per size class: every power of two from MinBuffer to MaxBuffer bytes.
+// A request is rounded up to the next size class and served from that class's free list.
+// - As in Object_Pool.cpp, buffers are carved out of slabs and the free list is intrusive. A free
+//   buffer holds no data, so the link to the next free buffer is stored in its first bytes and the
+//   free list costs no memory at all.
+// - Requests larger than MaxBuffer are not pooled; they go straight to the allocator.
+// - With hugePages set, slabs of the large size classes and oversize buffers are backed by memory
+//   aligned to 2 MB, and on Linux the kernel is asked to back it with transparent huge pages, which
+//   saves TLB misses when large buffers are streamed through.
+
+// Like std::pmr::unsynchronized_pool_resource, a BufferPool must not be shared between threads,
+// and the size of a buffer has to be given back on deallocate().
+
+// http://en.wikipedia.org/wiki/Slab_allocation
+// http://www.kernel.org/doc/html/latest/admin-guide/mm/transhuge.html
+
+#ifndef MY_BUFFERPOOL_HEADER
+#define MY_BUFFERPOOL_HEADER
+
+#include <new>
+#include <vector>
+#include <cstddef>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
+
+class BufferPool
+{
+	public:
+
+		static const std::size_t MinBuffer = 64;
+		static const std::size_t MaxBuffer = 1 << 20;
+		static const std::size_t SlabBytes = 256 * 1024;
+		static const std::size_t LargeBuffer = 64 * 1024;
+		static const std::size_t HugePageSize = 2 * 1024 * 1024;
+
+		explicit BufferPool(bool hugePages = false) : hugePages(hugePages)
+		{
+			for (std::size_t i = 0; i < Classes; i++)
+			{
+				classes[i].freeList = NULL;
+				classes[i].carved = NULL;
+				classes[i].end = NULL;
+			}
+		}
+
+		~BufferPool()
+		{
+			for (std::size_t i = 0; i < slabs.size(); i++)
+			{
+				releaseChunk(slabs[i].memory, slabs[i].huge);
+			}
+		}
+
+		// Returns a buffer of at least bytes bytes.
+		void * allocate(std::size_t bytes)
+		{
+			if (bytes > MaxBuffer)
+			{
+				return allocateChunk(bytes, hugePages);
+			}
+
+			std::size_t index = classOf(bytes);
+			SizeClass & sizeClass = classes[index];
+			FreeBuffer * buffer = sizeClass.freeList;
+
+			if (buffer != NULL)
+			{
+				sizeClass.freeList = buffer->next;
+
+				return buffer;
+			}
+
+			if (sizeClass.carved == sizeClass.end)
+			{
+				addSlab(sizeClass, classSize(index));
+			}
+
+			void * carved = sizeClass.carved;
+
+			sizeClass.carved += classSize(index);
+
+			return carved;
+		}
+
+		// Gives back a buffer obtained from allocate(bytes).
+		void deallocate(void * buffer, std::size_t bytes)
+		{
+			if (buffer == NULL)
+			{
+				return;
+			}
+
+			if (bytes > MaxBuffer)
+			{
+				releaseChunk(buffer, hugePages);
+
+				return;
+			}
+
+			SizeClass & sizeClass = classes[classOf(bytes)];
+			FreeBuffer * free = static_cast<FreeBuffer *>(buffer);
+
+			free->next = sizeClass.freeList;
+			sizeClass.freeList = free;
+		}
+
+		// Size of the buffer actually handed out for a request of bytes bytes.
+		static std::size_t capacity(std::size_t bytes)
+		{
+			return bytes > MaxBuffer ? bytes : classSize(classOf(bytes));
+		}
+
+	private:
+
+		static const std::size_t MinShift = 6;		// log2(MinBuffer)
+		static const std::size_t Classes = 15;		// MinBuffer, 2 * MinBuffer, ... MaxBuffer
+
+		struct FreeBuffer
+		{
+			FreeBuffer * next;
+		};
+
+		struct SizeClass
+		{
+			FreeBuffer * freeList;
+			char * carved;			// Next uncarved buffer of the newest slab.
+			char * end;				// End of the newest slab.
+		};
+
+		struct Slab
+		{
+			void * memory;
+			bool huge;
+		};
+
+		BufferPool(const BufferPool &); // not allowed
+		BufferPool & operator=(const BufferPool &); // not allowed
+
+		static std::size_t classOf(std::size_t bytes)
+		{
+			if (bytes <= MinBuffer)
+			{
+				return 0;
+			}
+
+			// Number of significant bits of (bytes - 1) / MinBuffer.
+#if defined(__GNUC__)
+			return 64 - __builtin_clzll(static_cast<unsigned long long>((bytes - 1) >> MinShift));
+#else
+			std::size_t index = 0;
+
+			for (std::size_t size = (bytes - 1) >> MinShift; size != 0; size >>= 1)
+			{
+				index++;
+			}
+
+			return index;
+#endif
+		}
+
+		static std::size_t classSize(std::size_t index)
+		{
+			return MinBuffer << index;
+		}
+
+		void addSlab(SizeClass & sizeClass, std::size_t size)
+		{
+			bool huge = hugePages && size >= LargeBuffer;
+			std::size_t bytes = huge ? HugePageSize : (size < SlabBytes ? SlabBytes : size);
+
+			Slab slab;
+
+			slab.memory = allocateChunk(bytes, huge);
+			slab.huge = huge;
+
+			slabs.push_back(slab);
+
+			sizeClass.carved = static_cast<char *>(slab.memory);
+			sizeClass.end = sizeClass.carved + bytes / size * size;
+		}
+
+		static void * allocateChunk(std::size_t bytes, bool huge)
+		{
+			if (!huge)
+			{
+				return ::operator new(bytes);
+			}
+
+			bytes = (bytes + HugePageSize - 1) / HugePageSize * HugePageSize;
+
+			void * memory = ::operator new(bytes, std::align_val_t(HugePageSize));
+
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+			// Only a hint: without transparent huge pages the memory is still 2 MB aligned.
+			madvise(memory, bytes, MADV_HUGEPAGE);
+#endif
+
+			return memory;
+		}
+
+		static void releaseChunk(void * memory, bool huge)
+		{
+			if (huge)
+			{
+				::operator delete(memory, std::align_val_t(HugePageSize));
+			}
+			else
+			{
+				::operator delete(memory);
+			}
+		}
+
+		const bool hugePages;
+		SizeClass classes[Classes];
+		std::vector<Slab> slabs;
+};
+
+#endif
@@ -0,0 +1,988 @@
+
+//************************************************************************/
+//* ObjectPool.h                                                         */
+//************************************************************************/
+
+// Generic, slab-backed Object Pool with RAII leases.
+
+// ObjectPool<T, ResetPolicy> pools objects of any default constructible type T.
+// - Objects are carved out of contiguous slabs and free ones are kept on an intrusive free list,
+//   exactly as in Object_Pool.cpp, so acquire() and release are O(1) and do not call the allocator.
+// - The action that brings a returned object back to its default state is a compile-time policy:
+//   a function object whose operator() receives the object. The call is resolved statically and is
+//   normally inlined, there is neither a virtual call nor a std::function in the way.
+// - acquire() returns a Lease, a move-only owner of the borrowed object. The object goes back to
+//   the pool when the Lease is destroyed, so an object can neither be forgotten nor returned twice.
+
+// The pool must outlive every Lease taken from it. It is not thread-safe; see Object_Pool_2.cpp
+// for a pool that can be shared between threads.
+
+// HandlePool<T, ResetPolicy, IndexBits> hands out PoolHandles instead of pointers. A handle is a
+// 32-bit value made of the index of the object's slot and the generation of that slot, which is
+// bumped every time an object is returned. resolve() finds the slot by index in O(1) and returns
+// NULL if the generations differ, so a handle kept after release() can never reach the object of
+// the next client - the check is cheap enough to stay on in production. Handles are also half the
+// size of a pointer, which packs the structures that store them more densely.
+// With the default IndexBits the pool holds up to 2^20 objects. Generation 0 is skipped, so that no
+// valid handle is 0, and the 12-bit generation of a slot cycles through its 4095 other values: a stale
+// handle is recognised unless its slot has been reused a multiple of 4095 times in the meantime.
+
+// BoundedObjectPool<T, ResetPolicy> never holds more than a fixed number of objects. Instead of
+// creating yet another object when all of them are in use, it makes the client wait, which gives
+// back-pressure under a load spike instead of unbounded memory growth. It can be shared between
+// threads and offers
+// - acquire(), which blocks until an object is free,
+// - try_acquire_for(timeout), which gives up after the timeout and returns an empty Lease,
+// - acquire_async(callback) / acquire_async(), which return at once and deliver the Lease to the
+//   callback / the future as soon as an object is free.
+// All waiters, blocking or not, are served strictly in FIFO order: a returned object is handed
+// directly to the oldest waiter, it is never up for grabs by a thread that arrives later.
+// If creating an object throws, the capacity it would have taken is handed on to the oldest waiter:
+// a blocking one retries creating an object itself; for an asynchronous one it is retried once on
+// the failing thread, and only if that fails too does it receive the error, the capacity moving on
+// to the next waiter.
+
+// A BoundedObjectPool can also be given PoolWatermarks:
+// - prefill() creates objects up front, up to the low watermark by default, optionally on several
+//   threads at once, so that the first clients do not pay for creating them;
+// - a background trimmer, started with start_trimmer(), destroys objects that have been idle for
+//   longer than the idle time while the pool holds more objects than the high watermark, so that
+//   the memory pinned by a burst is given back once the load goes away.
+
+#ifndef MY_OBJECTPOOL_HEADER
+#define MY_OBJECTPOOL_HEADER
+
+#include <new>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <exception>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+
+// Default ResetPolicy: calls the reset() member function of the object.
+template <class T>
+struct CallReset
+{
+	void operator()(T & object) const
+	{
+		object.reset();
+	}
+};
+
+// ResetPolicy for objects that carry no state between uses.
+template <class T>
+struct NoReset
+{
+	void operator()(T &) const
+	{
+	}
+};
+
+// Move-only handle to an object borrowed from a Pool.
+// Pool must have a member function release(T *) accessible to Lease.
+template <class T, class Pool>
+class Lease
+{
+	public:
+
+		Lease() : pool(NULL), object(NULL) { }
+
+		Lease(Pool * pool, T * object) : pool(pool), object(object) { }
+
+		Lease(Lease && other) noexcept : pool(other.pool), object(other.object)
+		{
+			other.object = NULL;
+		}
+
+		Lease & operator=(Lease && other) noexcept
+		{
+			if (this != &other)
+			{
+				reset();
+
+				pool = other.pool;
+				object = other.object;
+				other.object = NULL;
+			}
+
+			return *this;
+		}
+
+		~Lease()
+		{
+			reset();
+		}
+
+		// Returns the object to the pool before the Lease goes out of scope.
+		void reset()
+		{
+			if (object != NULL)
+			{
+				pool->release(object);
+				object = NULL;
+			}
+		}
+
+		T * get() const { return object; }
+		T & operator*() const { return *object; }
+		T * operator->() const { return object; }
+		explicit operator bool() const { return object != NULL; }
+
+	private:
+
+		Lease(const Lease &); // not allowed
+		Lease & operator=(const Lease &); // not allowed
+
+		Pool * pool;
+		T * object;
+};
+
+template <class T, class ResetPolicy = CallReset<T>, std::size_t SlabSize = 256>
+class ObjectPool : private ResetPolicy
+{
+	friend class Lease<T, ObjectPool>;
+
+	public:
+
+		typedef Lease<T, ObjectPool> lease_type;
+
+		explicit ObjectPool(const ResetPolicy & policy = ResetPolicy())
+			: ResetPolicy(policy), freeList(NULL), carved(SlabSize), inUse(0)
+		{
+		}
+
+		~ObjectPool()
+		{
+			// Destroying the pool while a Lease is alive would leave it dangling.
+			assert(inUse == 0);
+
+			for (std::size_t i = 0; i < slabs.size(); i++)
+			{
+				std::size_t used = (i + 1 == slabs.size()) ? carved : SlabSize;
+
+				for (std::size_t j = 0; j < used; j++)
+				{
+					slabs[i][j].object.~T();
+				}
+
+				::operator delete(slabs[i]);
+			}
+		}
+
+		// Borrows an object, creating a new one if all of them are in use.
+		lease_type acquire()
+		{
+			Slot * slot = freeList;
+
+			if (slot != NULL)
+			{
+				freeList = slot->next;
+			}
+			else
+			{
+				if (carved == SlabSize)
+				{
+					addSlab();
+				}
+
+				slot = slabs.back() + carved;
+
+				new (&slot->object) T;
+
+				carved++;
+			}
+
+			inUse++;
+
+			return lease_type(this, &slot->object);
+		}
+
+		// Number of objects created so far.
+		std::size_t size() const
+		{
+			return slabs.empty() ? 0 : (slabs.size() - 1) * SlabSize + carved;
+		}
+
+		// Number of objects waiting on the free list.
+		std::size_t available() const
+		{
+			return size() - inUse;
+		}
+
+	private:
+
+		// An object together with the link to the next free Slot.
+		// The link is only meaningful while the Slot is on the free list.
+		struct Slot
+		{
+			T object;
+			Slot * next;
+		};
+
+		ObjectPool(const ObjectPool &); // not allowed
+		ObjectPool & operator=(const ObjectPool &); // not allowed
+
+		// Called by Lease.
+		void release(T * object)
+		{
+			static_cast<ResetPolicy &>(*this)(*object);
+
+			// object is the first member of Slot, so the address of the one is the address of the other.
+			Slot * slot = reinterpret_cast<Slot *>(object);
+
+			slot->next = freeList;
+			freeList = slot;
+
+			inUse--;
+		}
+
+		void addSlab()
+		{
+			slabs.push_back(static_cast<Slot *>(::operator new(SlabSize * sizeof(Slot))));
+			carved = 0;
+		}
+
+		std::vector<Slot *> slabs;
+		Slot * freeList;
+		std::size_t carved;
+		std::size_t inUse;
+};
+
+// Reference to an object of a HandlePool. The default constructed handle refers to nothing.
+struct PoolHandle
+{
+	PoolHandle() : value(0) { }
+
+	explicit PoolHandle(std::uint32_t value) : value(value) { }
+
+	explicit operator bool() const { return value != 0; }
+
+	bool operator==(const PoolHandle & other) const { return value == other.value; }
+	bool operator!=(const PoolHandle & other) const { return value != other.value; }
+
+	std::uint32_t value;
+};
+
+template <class T, class ResetPolicy = CallReset<T>, unsigned IndexBits = 20, unsigned SlabBits = 8>
+class HandlePool : private ResetPolicy
+{
+	// With a single bit, skipping generation 0 would leave generation 1 only, and no stale handle would be caught.
+	static_assert(IndexBits < 31 && SlabBits <= IndexBits, "the generation needs at least two bits");
+
+	public:
+
+		static const std::uint32_t MaxObjects = 1u << IndexBits;
+
+		explicit HandlePool(const ResetPolicy & policy = ResetPolicy())
+			: ResetPolicy(policy), freeList(Nil), created(0), inUse(0)
+		{
+		}
+
+		~HandlePool()
+		{
+			for (std::uint32_t i = 0; i < created; i++)
+			{
+				slotAt(i).object.~T();
+			}
+
+			for (std::size_t i = 0; i < slabs.size(); i++)
+			{
+				::operator delete(slabs[i]);
+			}
+		}
+
+		// Borrows an object, creating a new one if all of them are in use.
+		PoolHandle acquire()
+		{
+			std::uint32_t index = freeList;
+
+			if (index != Nil)
+			{
+				freeList = slotAt(index).nextFree;
+			}
+			else
+			{
+				if (created == MaxObjects)
+				{
+					throw std::bad_alloc();
+				}
+
+				// A slab is only added when the existing ones are full, so that a constructor that threw
+				// leaves its slot, and the slab, to the next call instead of adding another one.
+				if (created == slabs.size() * SlabSize)
+				{
+					Slot * slab = static_cast<Slot *>(::operator new(SlabSize * sizeof(Slot)));
+
+					try
+					{
+						slabs.push_back(slab);
+					}
+					catch (...)
+					{
+						::operator delete(slab);
+						throw;
+					}
+				}
+
+				index = created;
+
+				Slot & slot = slotAt(index);
+
+				new (&slot.object) T;
+
+				slot.generation = 1;
+
+				created++;
+			}
+
+			inUse++;
+
+			return PoolHandle((slotAt(index).generation << IndexBits) | index);
+		}
+
+		// Returns the object the handle refers to, or NULL if it has been released since.
+		T * resolve(PoolHandle handle)
+		{
+			std::uint32_t index = handle.value & IndexMask;
+
+			if (index >= created)
+			{
+				return NULL;
+			}
+
+			Slot & slot = slotAt(index);
+
+			return (slot.generation == (handle.value >> IndexBits)) ? &slot.object : NULL;
+		}
+
+		bool valid(PoolHandle handle)
+		{
+			return resolve(handle) != NULL;
+		}
+
+		// Returns the object to the pool. Releasing a stale handle is detected and does nothing.
+		bool release(PoolHandle handle)
+		{
+			T * object = resolve(handle);
+
+			if (object == NULL)
+			{
+				return false;
+			}
+
+			static_cast<ResetPolicy &>(*this)(*object);
+
+			std::uint32_t index = handle.value & IndexMask;
+			Slot & slot = slotAt(index);
+
+			// Generation 0 is never used, so that no valid handle is ever 0.
+			slot.generation = (slot.generation + 1) & GenerationMask;
+
+			if (slot.generation == 0)
+			{
+				slot.generation = 1;
+			}
+
+			slot.nextFree = freeList;
+			freeList = index;
+
+			inUse--;
+
+			return true;
+		}
+
+		// Number of objects created so far.
+		std::size_t size() const
+		{
+			return created;
+		}
+
+		// Number of objects waiting on the free list.
+		std::size_t available() const
+		{
+			return created - inUse;
+		}
+
+	private:
+
+		static const std::uint32_t SlabSize = 1u << SlabBits;
+		static const std::uint32_t IndexMask = MaxObjects - 1;
+		static const std::uint32_t GenerationMask = (1u << (32 - IndexBits)) - 1;
+		static const std::uint32_t Nil = 0xFFFFFFFFu;
+
+		struct Slot
+		{
+			T object;
+			std::uint32_t generation;
+			std::uint32_t nextFree;		// Only meaningful while the slot is on the free list.
+		};
+
+		HandlePool(const HandlePool &); // not allowed
+		HandlePool & operator=(const HandlePool &); // not allowed
+
+		// Slabs are never moved, so the objects keep their addresses as the pool grows.
+		Slot & slotAt(std::uint32_t index)
+		{
+			return slabs[index >> SlabBits][index & (SlabSize - 1)];
+		}
+
+		std::vector<Slot *> slabs;
+		std::uint32_t freeList;
+		std::uint32_t created;
+		std::uint32_t inUse;
+};
+
+// Sizing hints for BoundedObjectPool.
+struct PoolWatermarks
+{
+	PoolWatermarks(std::size_t low = 0, std::size_t high = static_cast<std::size_t>(-1),
+				   std::chrono::milliseconds idleTime = std::chrono::milliseconds(30000))
+		: low(low), high(high), idleTime(idleTime)
+	{
+	}
+
+	std::size_t low;					// Number of objects created by prefill().
+	std::size_t high;					// The trimmer never goes below this number of objects.
+	std::chrono::milliseconds idleTime;	// How long an object above the high watermark may stay idle.
+};
+
+template <class T, class ResetPolicy = CallReset<T> >
+class BoundedObjectPool : private ResetPolicy
+{
+	friend class Lease<T, BoundedObjectPool>;
+
+	public:
+
+		typedef Lease<T, BoundedObjectPool> lease_type;
+		typedef std::function<void(lease_type)> callback_type;
+		typedef std::function<void(std::exception_ptr)> error_callback_type;
+
+		explicit BoundedObjectPool(std::size_t capacity, const ResetPolicy & policy = ResetPolicy())
+			: ResetPolicy(policy), maxObjects(capacity), created(0), trimming(false)
+		{
+			assert(capacity > 0);
+		}
+
+		BoundedObjectPool(std::size_t capacity, const PoolWatermarks & watermarks, const ResetPolicy & policy = ResetPolicy())
+			: ResetPolicy(policy), maxObjects(capacity), created(0), watermarks(watermarks), trimming(false)
+		{
+			assert(capacity > 0 && watermarks.low <= watermarks.high);
+		}
+
+		~BoundedObjectPool()
+		{
+			stop_trimmer();
+
+			// Destroying the pool while a Lease is alive would leave it dangling.
+			// Callbacks that are still waiting are dropped without being called.
+			assert(idle.size() == created);
+
+			for (std::size_t i = 0; i < waiters.size(); i++)
+			{
+				delete waiters[i];
+			}
+
+			for (std::size_t i = 0; i < idle.size(); i++)
+			{
+				delete idle[i].object;
+			}
+		}
+
+		// Creates objects until the pool holds n of them (never more than its capacity).
+		// With threads > 1 the objects are constructed on that many threads at once, which pays off
+		// when they are slow to build. Objects created here go straight to waiting clients, if any.
+		void prefill(std::size_t n, unsigned threads = 1)
+		{
+			std::size_t count;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				n = std::min(n, maxObjects);
+				count = (created < n) ? n - created : 0;
+				created += count;
+			}
+
+			if (count == 0)
+			{
+				return;
+			}
+
+			threads = static_cast<unsigned>(std::max<std::size_t>(1, std::min<std::size_t>(threads, count)));
+
+			std::vector<std::exception_ptr> errors(threads);
+			std::vector<std::thread> workers;
+
+			for (unsigned t = 1; t < threads; t++)
+			{
+				workers.push_back(std::thread(&BoundedObjectPool::create, this,
+											  count * t / threads, count * (t + 1) / threads, std::ref(errors[t])));
+			}
+
+			create(0, count / threads, errors[0]);
+
+			for (std::size_t t = 0; t < workers.size(); t++)
+			{
+				workers[t].join();
+			}
+
+			for (std::size_t t = 0; t < errors.size(); t++)
+			{
+				if (errors[t])
+				{
+					std::rethrow_exception(errors[t]);
+				}
+			}
+		}
+
+		// Creates objects up to the low watermark.
+		void prefill()
+		{
+			prefill(watermarks.low);
+		}
+
+		// Starts a background thread that wakes up every interval and trims the pool.
+		void start_trimmer(std::chrono::milliseconds interval)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (!trimming)
+			{
+				trimming = true;
+				trimmer = std::thread(&BoundedObjectPool::trimLoop, this, interval);
+			}
+		}
+
+		void stop_trimmer()
+		{
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				if (!trimming)
+				{
+					return;
+				}
+
+				trimming = false;
+			}
+
+			stopTrimmer.notify_one();
+			trimmer.join();
+		}
+
+		// Destroys objects that have been idle for longer than the idle time, oldest first,
+		// as long as the pool holds more objects than the high watermark.
+		// Returns the number of objects destroyed. Called by the trimmer, but may be called directly.
+		std::size_t trim()
+		{
+			std::vector<T *> victims;
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+
+				std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() - watermarks.idleTime;
+
+				while (created > watermarks.high && !idle.empty() && idle.front().since <= deadline)
+				{
+					victims.push_back(idle.front().object);
+					idle.pop_front();
+					created--;
+				}
+			}
+
+			// Destroy them outside the lock, as this may be as slow as creating them.
+			for (std::size_t i = 0; i < victims.size(); i++)
+			{
+				delete victims[i];
+			}
+
+			return victims.size();
+		}
+
+		// Borrows an object, waiting as long as it takes for one to become free.
+		lease_type acquire()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			T * object = take(lock);
+
+			if (object == NULL)
+			{
+				Waiter waiter;
+
+				waiters.push_back(&waiter);
+
+				while (object == NULL)
+				{
+					waiter.ready.wait(lock, [&waiter] { return waiter.object != NULL || waiter.retry; });
+
+					object = retry(lock, waiter);
+				}
+			}
+
+			return lease_type(this, object);
+		}
+
+		// Borrows an object, waiting at most timeout for one to become free.
+		// Returns an empty Lease if the timeout expires.
+		template <class Rep, class Period>
+		lease_type try_acquire_for(const std::chrono::duration<Rep, Period> & timeout)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + timeout;
+			T * object = take(lock);
+
+			if (object == NULL)
+			{
+				Waiter waiter;
+
+				waiters.push_back(&waiter);
+
+				while (object == NULL)
+				{
+					if (!waiter.ready.wait_until(lock, deadline, [&waiter] { return waiter.object != NULL || waiter.retry; }))
+					{
+						waiters.erase(std::find(waiters.begin(), waiters.end(), &waiter));
+
+						return lease_type();
+					}
+
+					object = retry(lock, waiter);
+				}
+			}
+
+			return lease_type(this, object);
+		}
+
+		// Delivers an object to callback as soon as one is free. The callback runs either right away
+		// on the calling thread or later on the thread that returns an object to the pool, so it
+		// should be short and must not block on this pool.
+		// If creating an object fails while the client waits, on_error receives the exception, on the
+		// thread where it was thrown; without on_error, callback receives an empty Lease instead.
+		void acquire_async(callback_type callback, error_callback_type on_error = error_callback_type())
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			T * object = take(lock);
+
+			if (object == NULL)
+			{
+				Waiter * waiter = new Waiter;
+
+				waiter->callback = std::move(callback);
+				waiter->failure = std::move(on_error);
+				waiters.push_back(waiter);
+
+				return;
+			}
+
+			lock.unlock();
+
+			callback(lease_type(this, object));
+		}
+
+		// Same as above, with the Lease delivered through a future.
+		std::future<lease_type> acquire_async()
+		{
+			std::shared_ptr<std::promise<lease_type> > promise(new std::promise<lease_type>);
+			std::future<lease_type> future = promise->get_future();
+
+			acquire_async([promise](lease_type lease) { promise->set_value(std::move(lease)); },
+						  [promise](std::exception_ptr error) { promise->set_exception(error); });
+
+			return future;
+		}
+
+		std::size_t capacity() const
+		{
+			return maxObjects;
+		}
+
+		// Number of objects created so far.
+		std::size_t size() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return created;
+		}
+
+		// Number of objects waiting on the free list.
+		std::size_t available() const
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			return idle.size();
+		}
+
+	private:
+
+		// A client waiting for an object. Blocking clients wait on ready, asynchronous ones leave
+		// a callback. release() hands the object over by storing it in the Waiter; when creating an
+		// object has failed and freed capacity, a blocking client is told to retry instead.
+		struct Waiter
+		{
+			Waiter() : object(NULL), retry(false) { }
+
+			T * object;
+			bool retry;
+			std::condition_variable ready;
+			callback_type callback;
+			error_callback_type failure;
+		};
+
+		BoundedObjectPool(const BoundedObjectPool &); // not allowed
+		BoundedObjectPool & operator=(const BoundedObjectPool &); // not allowed
+
+		// Takes a free object, or creates one while below capacity. Returns NULL if the client has
+		// to wait, which is also the case when earlier clients are already waiting, unless the client
+		// is the oldest waiter itself (first).
+		// The new object is constructed outside the lock, as it may be expensive to create.
+		T * take(std::unique_lock<std::mutex> & lock, bool first = false)
+		{
+			if (!waiters.empty() && !first)
+			{
+				return NULL;
+			}
+
+			if (!idle.empty())
+			{
+				T * object = idle.back().object;
+
+				idle.pop_back();
+
+				return object;
+			}
+
+			if (created == maxObjects)
+			{
+				return NULL;
+			}
+
+			created++;
+
+			lock.unlock();
+
+			T * object = NULL;
+
+			try
+			{
+				object = new T;
+			}
+			catch (...)
+			{
+				lock.lock();
+				created--;
+				creationFailed(lock, 1);
+				throw;
+			}
+
+			lock.lock();
+
+			return object;
+		}
+
+		// Called by a blocking waiter that has been woken up: returns the object it was handed, or
+		// tries to take or create one if it was told to retry, going back to the front of the queue
+		// if there is still none.
+		T * retry(std::unique_lock<std::mutex> & lock, Waiter & waiter)
+		{
+			if (waiter.object != NULL)
+			{
+				return waiter.object;
+			}
+
+			waiter.retry = false;
+
+			T * object = take(lock, true);
+
+			if (object == NULL)
+			{
+				waiters.push_front(&waiter);
+			}
+
+			return object;
+		}
+
+		// Called with the lock held when creating objects has failed, which frees freed objects of
+		// capacity. The clients at the front of the queue may be waiting for that capacity rather than
+		// for an object to be returned, which might never happen, so every freed object goes to a
+		// client that uses it: a blocking client is woken up to retry creating an object itself; for an
+		// asynchronous client, which has no thread of its own, creating one is retried here, once.
+		// If that fails too, the client receives its error and the capacity goes to the next one.
+		void creationFailed(std::unique_lock<std::mutex> & lock, std::size_t freed)
+		{
+			while (freed > 0 && !waiters.empty())
+			{
+				Waiter * waiter = waiters.front();
+
+				waiters.pop_front();
+
+				if (!waiter->callback)
+				{
+					waiter->retry = true;
+					waiter->ready.notify_one();
+					freed--;
+
+					continue;
+				}
+
+				created++;
+
+				lock.unlock();
+
+				T * object = NULL;
+				std::exception_ptr error;
+
+				try
+				{
+					object = new T;
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+				}
+
+				callback_type callback = std::move(waiter->callback);
+				error_callback_type failure = std::move(waiter->failure);
+
+				delete waiter;
+
+				if (object != NULL)
+				{
+					callback(lease_type(this, object));
+
+					lock.lock();
+					freed--;
+
+					continue;
+				}
+
+				lock.lock();
+				created--;
+				lock.unlock();
+
+				if (failure)
+				{
+					failure(error);
+				}
+				else
+				{
+					callback(lease_type());
+				}
+
+				lock.lock();
+			}
+		}
+
+		// Called by Lease.
+		void release(T * object)
+		{
+			static_cast<ResetPolicy &>(*this)(*object);
+
+			put(object);
+		}
+
+		// Hands a free object to the oldest waiter, or puts it on the free list.
+		void put(T * object)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			if (waiters.empty())
+			{
+				idle.push_back(Idle(object, std::chrono::steady_clock::now()));
+
+				return;
+			}
+
+			Waiter * waiter = waiters.front();
+
+			waiters.pop_front();
+
+			if (!waiter->callback)
+			{
+				waiter->object = object;
+				waiter->ready.notify_one();
+
+				return;
+			}
+
+			lock.unlock();
+
+			callback_type callback = std::move(waiter->callback);
+
+			delete waiter;
+
+			callback(lease_type(this, object));
+		}
+
+		// Constructs objects number first to last - 1 of a prefill() batch.
+		void create(std::size_t first, std::size_t last, std::exception_ptr & error)
+		{
+			for (std::size_t i = first; i < last; i++)
+			{
+				T * object = NULL;
+
+				try
+				{
+					object = new T;
+				}
+				catch (...)
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+
+					created -= last - i;
+					error = std::current_exception();
+					creationFailed(lock, last - i);
+
+					return;
+				}
+
+				put(object);
+			}
+		}
+
+		void trimLoop(std::chrono::milliseconds interval)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+
+			while (!stopTrimmer.wait_for(lock, interval, [this] { return !trimming; }))
+			{
+				lock.unlock();
+				trim();
+				lock.lock();
+			}
+		}
+
+		// A free object and the moment it was returned.
+		struct Idle
+		{
+			Idle(T * object, std::chrono::steady_clock::time_point since) : object(object), since(since) { }
+
+			T * object;
+			std::chrono::steady_clock::time_point since;
+		};
+
+		const std::size_t maxObjects;
+		std::size_t created;
+		std::deque<Idle> idle;				// Most recently returned at the back, so the front is idle the longest.
+		std::deque<Waiter *> waiters;
+		mutable std::mutex mutex;
+
+		PoolWatermarks watermarks;
+		bool trimming;
+		std::thread trimmer;
+		std::condition_variable stopTrimmer;
+};
+
+#endif
@@ -25,14 +25,35 @@
 // For example, if we work with databases, when a connection is closed it is not necessarily destroyed 
 // and it means that it can be reused by another client.
 
+// Slab allocation
+// Handing out objects that were allocated one by one with new, and remembering the free ones in a
+// std::list, means the pool still calls the allocator on every cycle: each returnResource() creates a
+// list node and each miss in getResource() creates a Resource. Instead the pool below carves Resources
+// out of slabs - contiguous chunks that hold SlabSize of them - and keeps the free ones on an intrusive
+// free list, i.e. the link to the next free slot is stored in the slot itself. Getting and returning a
+// Resource are then O(1) pointer operations without any allocator call, the allocator is only visited
+// once per SlabSize newly created Resources, and Resources that are in use together sit next to each
+// other in memory.
+
+// Instrumentation
+// The pool keeps PoolStats (see PoolStats.h): relaxed atomic counters of hits, misses, returns, objects
+// in use and free, plus a histogram of how long getResource() took. They are cheap enough to stay on
+// in production and can be dumped as text or JSON whenever needed, which replaces printing a line to
+// the console on every request.
+
 // http://en.wikipedia.org/wiki/Object_pool_pattern
 // http://www.oodesign.com/object-pool-pattern.html
+// http://en.wikipedia.org/wiki/Slab_allocation
 
 
-#include <list>
+#include <new>
+#include <chrono>
+#include <vector>
 #include <string>
 #include <iostream>
 
+#include "PoolStats.h"
+
 using namespace std;
 
 // Resource - wraps the limited reusable resource which will be shared by several clients for a limited amount of time.
@@ -89,22 +110,33 @@ class ObjectPool
 		// have been used at the time of the request.
 		Resource * getResource()
 		{
-			if (resources.empty())
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+			Slot * slot = freeList;
+
+			if (slot == NULL)
 			{
-				cout << "Creating a new Resource." << endl;
+				if (carved == SlabSize)
+				{
+					addSlab();
+				}
+
+				slot = slabs.back() + carved++;
 
-				return new Resource;
+				new (&slot->resource) Resource;
+
+				stats.miss();
 			}
 			else
 			{
-				cout << "Reusing an existing Resource." << endl;
+				freeList = slot->next;
 
-				Resource * resource = resources.front();
+				stats.hit();
+			}
 
-				resources.pop_front();
+			stats.acquireLatency(chrono::steady_clock::now() - start);
 
-				return resource;
-			}
+			return &slot->resource;
 		}
  
 		// Return Resource back to the pool.
@@ -115,18 +147,70 @@ class ObjectPool
 			if (object != NULL)
 			{
 				object->reset();
-				resources.push_back(object);
+
+				// Resource is the first member of Slot, so the address of the one is the address of the other.
+				Slot * slot = reinterpret_cast<Slot *>(object);
+
+				slot->next = freeList;
+				freeList = slot;
+
+				stats.returned();
+			}
+		}
+
+		// Hit rate, occupancy and acquire latency of the pool.
+		const PoolStats & getStats() const
+		{
+			return stats;
+		}
+
+		~ObjectPool()
+		{
+			for (size_t i = 0; i < slabs.size(); i++)
+			{
+				size_t used = (i + 1 == slabs.size()) ? carved : SlabSize;
+
+				for (size_t j = 0; j < used; j++)
+				{
+					slabs[i][j].resource.~Resource();
+				}
+
+				::operator delete(slabs[i]);
 			}
 		}
 
 	private:
 
+		static const size_t SlabSize = 256;
+
+		// A Resource together with the link to the next free Slot.
+		// The link is only meaningful while the Slot is on the free list.
+		struct Slot
+		{
+			Resource resource;
+			Slot * next;
+		};
+
 		// The private constructor can only be accessed from static method inside the class itself.
 		// By providing a private constructor we prevent class instances from being created in any 
 		// place other than this very class.
-		ObjectPool() {}
+		ObjectPool() : freeList(NULL), carved(SlabSize) {}
 
-		list<Resource *> resources;
+		ObjectPool(const ObjectPool &); // disallowed
+		ObjectPool & operator=(const ObjectPool &); // disallowed
+
+		// Allocates raw memory for the next SlabSize Resources.
+		// They are constructed one at a time as the pool grows.
+		void addSlab()
+		{
+			slabs.push_back(static_cast<Slot *>(::operator new(SlabSize * sizeof(Slot))));
+			carved = 0;
+		}
+
+		vector<Slot *> slabs;	// Every slab ever allocated; the last one is being carved.
+		Slot * freeList;		// Returned Slots, most recently returned first.
+		size_t carved;			// Number of Slots of the last slab that hold a Resource.
+		PoolStats stats;
         
 		static ObjectPool * instance;
 };
@@ -169,6 +253,12 @@ int main()
 
 	r3 = pool->getResource();
 	cout << "r3 = " << r3->getValue() << " [" << r3 << "]" << endl;
+
+	// Four resources were created, two were reused and two were returned.
+	cout << endl;
+	pool->getStats().writeText(cout);
+	pool->getStats().writeJson(cout);
+	cout << endl;
    
 	system("pause");
 
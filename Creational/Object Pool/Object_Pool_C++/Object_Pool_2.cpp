@@ -0,0 +1,394 @@
+// Object Pool Design Pattern - Creational Category
+
+// Thread-safe variant of Object_Pool.cpp.
+
+// The pool in Object_Pool.cpp is meant for a single client thread: getInstance() creates the
+// singleton behind an unguarded "if (instance == 0)" and the free resources are kept in a plain
+// std::list, so two threads calling getResource() at the same time corrupt the pool.
+
+// This version keeps the same Resource / ObjectPool / Client roles and the same interface, but:
+// - getInstance() uses a function-local static, whose initialization is thread-safe since C++11.
+// - Resources live in Slots that are allocated in chunks and never freed while the pool is alive,
+//   so a Slot can be named by a 32-bit index.
+// - Free Slots are kept on a shared lock-free stack (Treiber stack). The head packs the index of
+//   the top Slot together with a version tag which is bumped on every update, so a Slot that is
+//   popped and pushed back between our load and our compare-and-swap cannot fool us (ABA problem).
+// - Every thread keeps a small cache of free Slots in front of the shared stack. Most acquire /
+//   release pairs are served from the cache without touching any shared memory at all, and the
+//   shared stack is only visited in batches when the cache runs empty or full.
+
+// Neither path ever takes a lock. Growing the pool is lock-free as well: a new Slot index is
+// reserved with fetch_add and the chunk that holds it is installed with a compare-and-swap.
+
+// http://en.wikipedia.org/wiki/Object_pool_pattern
+// http://en.wikipedia.org/wiki/Treiber_Stack
+// http://en.wikipedia.org/wiki/ABA_problem
+
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+
+using namespace std;
+
+// Resource - wraps the limited reusable resource which will be shared by several clients for a limited amount of time.
+class Resource
+{
+	public:
+
+		Resource()
+		{
+			value = 0;
+		}
+
+		void reset()
+		{
+			value = 0;
+		}
+
+		int getValue()
+		{
+			return value;
+		}
+
+		void setValue(int val)
+		{
+			value = val;
+		}
+
+	private:
+
+		int value;
+};
+
+// ObjectPool - creates and manages the reusable objects for the use by Clients.
+// Note: this class is a singleton and may be used from any number of threads.
+class ObjectPool
+{
+	public:
+
+		// Static method for accessing class instance.
+		// Part of Singleton design pattern.
+		// Returns ObjectPool instance.
+		static ObjectPool * getInstance()
+		{
+			// Initialization of a function-local static is guaranteed to happen exactly once,
+			// even if several threads call getInstance() for the first time simultaneously.
+			static ObjectPool instance;
+
+			return &instance;
+		}
+
+		// Returns an instance of Resource.
+		// New Resource will be created if all the resources
+		// have been used at the time of the request.
+		Resource * getResource()
+		{
+			LocalCache & cache = localCache();
+
+			if (cache.count == 0)
+			{
+				refill(cache);
+			}
+
+			if (cache.count == 0)
+			{
+				return &slotAt(newSlot())->resource;
+			}
+
+			return &slotAt(cache.slots[--cache.count])->resource;
+		}
+
+		// Return Resource back to the pool.
+		// The resource must be initialized back to the default
+		// settings before someone else attempts to use it.
+		void returnResource(Resource * object)
+		{
+			if (object != NULL)
+			{
+				object->reset();
+
+				LocalCache & cache = localCache();
+
+				if (cache.count == CacheSize)
+				{
+					drain(cache, CacheSize / 2);
+				}
+
+				// Resource is the first member of the standard-layout Slot,
+				// so the address of the one is the address of the other.
+				cache.slots[cache.count++] = reinterpret_cast<Slot *>(object)->index;
+			}
+		}
+
+		~ObjectPool()
+		{
+			for (uint32_t i = 0; i < MaxChunks; i++)
+			{
+				delete [] chunks[i].load(memory_order_relaxed);
+			}
+		}
+
+	private:
+
+		static const uint32_t ChunkBits = 10;
+		static const uint32_t ChunkSize = 1u << ChunkBits;
+		static const uint32_t MaxChunks = 4096;
+		static const uint32_t CacheSize = 32;
+		static const uint32_t Nil = 0xFFFFFFFFu;
+
+		// Slots are cache line aligned so that resources handed to different threads
+		// never share a cache line (false sharing).
+		struct alignas(64) Slot
+		{
+			Resource resource;
+			uint32_t index;
+			atomic<uint32_t> next;
+		};
+
+		// Per-thread stack of free Slot indices sitting in front of the shared free list.
+		struct LocalCache
+		{
+			LocalCache() : count(0) { }
+
+			// Give the cached Slots back to the shared free list when the thread exits,
+			// otherwise they would be lost to the other threads.
+			~LocalCache()
+			{
+				if (count != 0)
+				{
+					ObjectPool::getInstance()->drain(*this, count);
+				}
+			}
+
+			uint32_t count;
+			uint32_t slots[CacheSize];
+		};
+
+		// The private constructor can only be accessed from static method inside the class itself.
+		// By providing a private constructor we prevent class instances from being created in any
+		// place other than this very class.
+		ObjectPool() : head(pack(Nil, 0)), nextIndex(0)
+		{
+			for (uint32_t i = 0; i < MaxChunks; i++)
+			{
+				chunks[i].store(NULL, memory_order_relaxed);
+			}
+		}
+
+		ObjectPool(const ObjectPool &); // disallowed
+		ObjectPool & operator=(const ObjectPool &); // disallowed
+
+		static LocalCache & localCache()
+		{
+			thread_local LocalCache cache;
+
+			return cache;
+		}
+
+		static uint64_t pack(uint32_t index, uint32_t tag)
+		{
+			return (static_cast<uint64_t>(tag) << 32) | index;
+		}
+
+		Slot * slotAt(uint32_t index)
+		{
+			return &chunks[index >> ChunkBits].load(memory_order_acquire)[index & (ChunkSize - 1)];
+		}
+
+		// Reserves a brand new Slot, installing the chunk that holds it if nobody has done so yet.
+		uint32_t newSlot()
+		{
+			uint32_t index = nextIndex.fetch_add(1, memory_order_relaxed);
+
+			if (index >= MaxChunks * ChunkSize)
+			{
+				throw bad_alloc();
+			}
+
+			atomic<Slot *> & chunk = chunks[index >> ChunkBits];
+
+			if (chunk.load(memory_order_acquire) == NULL)
+			{
+				Slot * fresh = new Slot[ChunkSize];
+				uint32_t base = index & ~(ChunkSize - 1);
+
+				for (uint32_t i = 0; i < ChunkSize; i++)
+				{
+					fresh[i].index = base + i;
+				}
+
+				Slot * expected = NULL;
+
+				if (!chunk.compare_exchange_strong(expected, fresh, memory_order_acq_rel, memory_order_acquire))
+				{
+					// Another thread installed the chunk first.
+					delete [] fresh;
+				}
+			}
+
+			return index;
+		}
+
+		// Moves up to half a cache worth of Slots from the shared free list into the thread cache.
+		void refill(LocalCache & cache)
+		{
+			while (cache.count < CacheSize / 2)
+			{
+				uint64_t top = head.load(memory_order_acquire);
+				uint32_t index;
+
+				do
+				{
+					index = static_cast<uint32_t>(top);
+
+					if (index == Nil)
+					{
+						return;
+					}
+				}
+				while (!head.compare_exchange_weak(top,
+												   pack(slotAt(index)->next.load(memory_order_relaxed), static_cast<uint32_t>(top >> 32) + 1),
+												   memory_order_acquire, memory_order_acquire));
+
+				cache.slots[cache.count++] = index;
+			}
+		}
+
+		// Links the top n Slots of the thread cache together and pushes them onto the shared free list
+		// with a single compare-and-swap.
+		void drain(LocalCache & cache, uint32_t n)
+		{
+			uint32_t first = cache.slots[cache.count - n];
+
+			for (uint32_t i = cache.count - n; i + 1 < cache.count; i++)
+			{
+				slotAt(cache.slots[i])->next.store(cache.slots[i + 1], memory_order_relaxed);
+			}
+
+			Slot * last = slotAt(cache.slots[cache.count - 1]);
+			uint64_t top = head.load(memory_order_relaxed);
+
+			do
+			{
+				last->next.store(static_cast<uint32_t>(top), memory_order_relaxed);
+			}
+			while (!head.compare_exchange_weak(top, pack(first, static_cast<uint32_t>(top >> 32) + 1),
+											   memory_order_release, memory_order_relaxed));
+
+			cache.count -= n;
+		}
+
+		atomic<uint64_t> head;
+		atomic<uint32_t> nextIndex;
+		atomic<Slot *> chunks[MaxChunks];
+};
+
+
+// Client - every worker thread repeatedly borrows a few resources, uses them and gives them back.
+void client(ObjectPool * pool, int iterations)
+{
+	const int batch = 4;
+	Resource * borrowed[batch];
+
+	for (int i = 0; i < iterations; i++)
+	{
+		for (int j = 0; j < batch; j++)
+		{
+			borrowed[j] = pool->getResource();
+			borrowed[j]->setValue(i + j);
+		}
+
+		for (int j = 0; j < batch; j++)
+		{
+			pool->returnResource(borrowed[j]);
+		}
+	}
+}
+
+
+int main()
+{
+	Resource *r1, *r2, *r3;
+	ObjectPool * pool = ObjectPool::getInstance();
+
+	// Resources will be created.
+	r1 = pool->getResource();
+	r1->setValue(10);
+	cout << "r1 = " << r1->getValue() << " [" << r1 << "]" << endl;
+
+	r2 = pool->getResource();
+	r2->setValue(20);
+	cout << "r2 = " << r2->getValue() << " [" << r2 << "]" << endl;
+
+	// Return the resources. They go into this thread's cache, not into the shared free list.
+	pool->returnResource(r2);
+	pool->returnResource(r1);
+
+	// Resources will be reused from the cache.
+	r1 = pool->getResource();
+	cout << "r1 = " << r1->getValue() << " [" << r1 << "]" << endl;
+
+	r2 = pool->getResource();
+	cout << "r2 = " << r2->getValue() << " [" << r2 << "]" << endl;
+
+	// A new resource will be created.
+	r3 = pool->getResource();
+	cout << "r3 = " << r3->getValue() << " [" << r3 << "]" << endl;
+
+	pool->returnResource(r1);
+	pool->returnResource(r2);
+	pool->returnResource(r3);
+
+	// Throughput of acquire / release pairs with an increasing number of client threads.
+	// The total amount of work is the same for every row.
+	const int total_iterations = 1 << 20;
+
+	cout << endl << "threads    acquire/release per second" << endl;
+
+	for (int threads = 1; threads <= 64; threads *= 2)
+	{
+		vector<thread> workers;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		for (int t = 0; t < threads; t++)
+		{
+			workers.push_back(thread(client, pool, total_iterations / threads));
+		}
+
+		for (size_t t = 0; t < workers.size(); t++)
+		{
+			workers[t].join();
+		}
+
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+		// Every iteration performs 4 acquire / release pairs.
+		double pairs = 4.0 * (total_iterations / threads) * threads;
+
+		cout << threads << "\t   " << static_cast<long long>(pairs / elapsed.count()) << endl;
+	}
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the addresses and the throughput figures will vary):
+/*
+r1 = 10 [0x55d0c2a4a040]
+r2 = 20 [0x55d0c2a4a080]
+r1 = 0 [0x55d0c2a4a040]
+r2 = 0 [0x55d0c2a4a080]
+r3 = 0 [0x55d0c2a4a0c0]
+
+threads    acquire/release per second
+1	   ...
+2	   ...
+...
+64	   ...
+*/
@@ -0,0 +1,188 @@
+// Object Pool Design Pattern - Creational Category
+
+// Generic Object Pool with RAII leases.
+
+// In Object_Pool.cpp the Client is responsible for giving every Resource back with returnResource().
+// The sample itself forgets to return r3, so that Resource is lost to the pool, and nothing stops a
+// client from returning the same Resource twice.
+
+// ObjectPool<T, ResetPolicy> in ObjectPool.h removes both problems. acquire() hands out a Lease,
+// a move-only owner of the borrowed object, and the Lease gives the object back when it goes out of
+// scope. The reset action is a template parameter, so pooling a new type only takes a small function
+// object, and the call to it is resolved at compile time.
+
+// http://en.wikipedia.org/wiki/Object_pool_pattern
+// http://en.wikipedia.org/wiki/Resource_Acquisition_Is_Initialization
+
+#include <string>
+#include <vector>
+#include <iostream>
+
+#include "ObjectPool.h"
+
+using namespace std;
+
+// Resource - wraps the limited reusable resource which will be shared by several clients for a limited amount of time.
+class Resource
+{
+	public:
+
+		Resource()
+		{
+			value = 0;
+		}
+
+		void reset()
+		{
+			value = 0;
+		}
+
+		int getValue()
+		{
+			return value;
+		}
+
+		void setValue(int val)
+		{
+			value = val;
+		}
+
+	private:
+
+		int value;
+};
+
+// A message buffer. Pooling it keeps the memory that the buffer has already grown to.
+typedef vector<char> MessageBuffer;
+
+// Empties the buffer but keeps its capacity.
+struct ClearBuffer
+{
+	void operator()(MessageBuffer & buffer) const
+	{
+		buffer.clear();
+	}
+};
+
+// A parser that is expensive to construct (think of compiled tables), but cheap to reset.
+class Parser
+{
+	public:
+
+		Parser() : fields(0)
+		{
+			table.resize(4096);
+		}
+
+		void reset()
+		{
+			fields = 0;
+		}
+
+		void parse(const MessageBuffer & buffer)
+		{
+			for (size_t i = 0; i < buffer.size(); i++)
+			{
+				if (buffer[i] == ',')
+				{
+					fields++;
+				}
+			}
+
+			fields++;
+		}
+
+		int getFields() const
+		{
+			return fields;
+		}
+
+	private:
+
+		vector<int> table;
+		int fields;
+};
+
+
+int main()
+{
+	ObjectPool<Resource> pool;
+
+	{
+		// Resources will be created.
+		ObjectPool<Resource>::lease_type r1 = pool.acquire();
+		r1->setValue(10);
+		cout << "r1 = " << r1->getValue() << " [" << r1.get() << "]" << endl;
+
+		ObjectPool<Resource>::lease_type r2 = pool.acquire();
+		r2->setValue(20);
+		cout << "r2 = " << r2->getValue() << " [" << r2.get() << "]" << endl;
+
+		ObjectPool<Resource>::lease_type r3 = pool.acquire();
+		r3->setValue(30);
+		cout << "r3 = " << r3->getValue() << " [" << r3.get() << "]" << endl;
+
+		// Return two of the resources early. r3 is returned at the end of the scope,
+		// it can no longer be forgotten.
+		r1.reset();
+		r2.reset();
+
+		cout << "created " << pool.size() << ", available " << pool.available() << endl;
+	}
+
+	cout << "created " << pool.size() << ", available " << pool.available() << endl;
+
+	// Leases can be moved, e.g. into a container, but never copied.
+	vector<ObjectPool<Resource>::lease_type> leases;
+
+	for (int i = 0; i < 3; i++)
+	{
+		leases.push_back(pool.acquire());
+		cout << "r" << i + 1 << " = " << leases.back()->getValue() << " [" << leases.back().get() << "]" << endl;
+	}
+
+	leases.clear();
+
+	// Pools of other types only need a reset policy.
+	ObjectPool<MessageBuffer, ClearBuffer> buffers;
+	ObjectPool<Parser> parsers;
+
+	const char * messages[] = { "a,b,c", "1,2", "x,y,z,w" };
+
+	for (int i = 0; i < 3; i++)
+	{
+		ObjectPool<MessageBuffer, ClearBuffer>::lease_type buffer = buffers.acquire();
+		ObjectPool<Parser>::lease_type parser = parsers.acquire();
+
+		for (const char * c = messages[i]; *c != '\0'; c++)
+		{
+			buffer->push_back(*c);
+		}
+
+		parser->parse(*buffer);
+
+		cout << messages[i] << ": " << parser->getFields() << " fields, buffer capacity " << buffer->capacity() << endl;
+	}
+
+	cout << "buffers created " << buffers.size() << ", parsers created " << parsers.size() << endl;
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the addresses will vary):
+/*
+r1 = 10 [0x5604e4c3d2c0]
+r2 = 20 [0x5604e4c3d2d0]
+r3 = 30 [0x5604e4c3d2e0]
+created 3, available 2
+created 3, available 3
+r1 = 0 [0x5604e4c3d2e0]
+r2 = 0 [0x5604e4c3d2d0]
+r3 = 0 [0x5604e4c3d2c0]
+a,b,c: 3 fields, buffer capacity 8
+1,2: 2 fields, buffer capacity 8
+x,y,z,w: 4 fields, buffer capacity 8
+buffers created 1, parsers created 1
+*/
@@ -0,0 +1,245 @@
+// Object Pool Design Pattern - Creational Category
+
+// Bounded Object Pool.
+
+// When the pool in Object_Pool.cpp runs out of free Resources it simply creates another one, so under
+// a load spike the number of Resources - and the memory they hold - grows without limit. For objects
+// that stand for something scarce, such as database connections, the pool should rather cap their
+// number and let the clients wait for one to be returned.
+
+// BoundedObjectPool<T, ResetPolicy> in ObjectPool.h never creates more than capacity() objects.
+// Clients can block in acquire(), give up after a timeout with try_acquire_for(), or register with
+// acquire_async() and get the object through a callback or a future. Waiting clients are served in
+// the order in which they arrived.
+// When opening a connection fails, the capacity it would have taken goes to the waiting clients, so
+// that a client queued behind the failure is not left waiting for a connection that never comes.
+
+// http://en.wikipedia.org/wiki/Object_pool_pattern
+// http://en.wikipedia.org/wiki/Back_pressure
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+#include <iostream>
+#include <stdexcept>
+
+#include "ObjectPool.h"
+
+using namespace std;
+
+// Serializes the output of the client threads.
+mutex console;
+
+// Stand-in for a database handle: slow to open, and the server accepts only a few of them.
+class DbConnection
+{
+	public:
+
+		DbConnection() : queries(0)
+		{
+			this_thread::sleep_for(chrono::milliseconds(20));
+
+			id = ++opened;
+		}
+
+		void reset()
+		{
+			queries = 0;
+		}
+
+		void query(int client)
+		{
+			queries++;
+
+			this_thread::sleep_for(chrono::milliseconds(10));
+
+			lock_guard<mutex> lock(console);
+			cout << "client " << client << " used connection " << id << endl;
+		}
+
+		int getId() const
+		{
+			return id;
+		}
+
+	private:
+
+		int id;
+		int queries;
+
+		// Connections are opened outside the pool's lock, possibly by several threads at once.
+		static atomic<int> opened;
+};
+
+atomic<int> DbConnection::opened(0);
+
+typedef BoundedObjectPool<DbConnection> ConnectionPool;
+
+// A connection to a server that is down for the next few attempts to connect.
+class FlakyConnection
+{
+	public:
+
+		FlakyConnection()
+		{
+			this_thread::sleep_for(chrono::milliseconds(50));
+
+			if (failures-- > 0)
+			{
+				throw runtime_error("server unavailable");
+			}
+		}
+
+		void reset() { }
+
+		static atomic<int> failures;
+
+	private:
+
+		FlakyConnection(const FlakyConnection &); // not allowed
+		FlakyConnection & operator=(const FlakyConnection &); // not allowed
+};
+
+atomic<int> FlakyConnection::failures(0);
+
+typedef BoundedObjectPool<FlakyConnection> FlakyPool;
+
+
+// Client - runs a query on a pooled connection.
+void client(ConnectionPool * pool, int id)
+{
+	ConnectionPool::lease_type connection = pool->acquire();
+
+	connection->query(id);
+}
+
+
+int main()
+{
+	ConnectionPool pool(3);
+
+	// Eight clients compete for three connections.
+	// Only three connections are ever opened, the other clients wait for one of them.
+	vector<thread> clients;
+
+	for (int i = 1; i <= 8; i++)
+	{
+		clients.push_back(thread(client, &pool, i));
+	}
+
+	for (size_t i = 0; i < clients.size(); i++)
+	{
+		clients[i].join();
+	}
+
+	cout << "connections opened: " << pool.size() << " of " << pool.capacity() << endl << endl;
+
+	// Take all the connections, then try to get one more.
+	vector<ConnectionPool::lease_type> held;
+
+	for (size_t i = 0; i < pool.capacity(); i++)
+	{
+		held.push_back(pool.acquire());
+	}
+
+	ConnectionPool::lease_type extra = pool.try_acquire_for(chrono::milliseconds(50));
+
+	cout << "try_acquire_for(50ms) " << (extra ? "succeeded" : "timed out") << endl;
+
+	// Asynchronous clients are queued and served in FIFO order as connections are returned.
+	for (int i = 1; i <= 2; i++)
+	{
+		pool.acquire_async([i](ConnectionPool::lease_type connection)
+		{
+			cout << "callback " << i << " got connection " << connection->getId() << endl;
+		});
+	}
+
+	future<ConnectionPool::lease_type> pending = pool.acquire_async();
+
+	cout << "returning connections" << endl;
+
+	held.clear();
+
+	cout << "future got connection " << pending.get()->getId() << endl << endl;
+
+	// A single connection, and the server fails the next two attempts to open one. The first client
+	// fails while an asynchronous and a blocking client queue up behind it; the asynchronous one is
+	// retried once and gets the second failure; the blocking one must still get a connection.
+	FlakyPool flaky(1);
+	string creator, blocking;
+
+	FlakyConnection::failures = 2;
+
+	thread first([&flaky, &creator]()
+	{
+		try
+		{
+			flaky.acquire();
+			creator = "got a connection";
+		}
+		catch (const exception & e)
+		{
+			creator = e.what();
+		}
+	});
+
+	this_thread::sleep_for(chrono::milliseconds(10));
+
+	future<FlakyPool::lease_type> queued = flaky.acquire_async();
+
+	thread second([&flaky, &blocking]()
+	{
+		FlakyPool::lease_type connection = flaky.try_acquire_for(chrono::seconds(2));
+
+		blocking = connection ? "got a connection" : "timed out";
+	});
+
+	first.join();
+	second.join();
+
+	cout << "first client: " << creator << endl;
+
+	try
+	{
+		queued.get();
+		cout << "asynchronous client: got a connection" << endl;
+	}
+	catch (const exception & e)
+	{
+		cout << "asynchronous client: " << e.what() << endl;
+	}
+
+	cout << "blocking client: " << blocking << ", connections opened: " << flaky.size() << endl;
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the order of the first eight lines and the connection ids will vary):
+/*
+client 1 used connection 1
+client 2 used connection 2
+client 3 used connection 3
+client 4 used connection 1
+client 5 used connection 2
+client 6 used connection 3
+client 7 used connection 1
+client 8 used connection 2
+connections opened: 3 of 3
+
+try_acquire_for(50ms) timed out
+returning connections
+callback 1 got connection 2
+callback 2 got connection 2
+future got connection 2
+
+first client: server unavailable
+asynchronous client: server unavailable
+blocking client: got a connection, connections opened: 1
+*/
@@ -0,0 +1,139 @@
+// Object Pool Design Pattern - Creational Category
+
+// Object Pool with watermarks, prefill and background trimming.
+
+// The pool in Object_Pool.cpp only ever grows: every Resource that was needed once during a burst
+// stays in the pool forever, and the first clients after start-up pay for creating the Resources.
+
+// BoundedObjectPool in ObjectPool.h accepts PoolWatermarks:
+// - prefill() creates the low watermark worth of objects at start-up, optionally on several threads,
+//   which gives a predictable latency for the first requests;
+// - the trimmer destroys objects that stay idle for longer than the idle time while the pool holds
+//   more than the high watermark, which bounds the memory kept after a burst.
+
+// http://en.wikipedia.org/wiki/Object_pool_pattern
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <iostream>
+
+#include "ObjectPool.h"
+
+using namespace std;
+
+// An object that is slow to build, e.g. a session that has to load configuration.
+class Session
+{
+	public:
+
+		Session() : requests(0)
+		{
+			this_thread::sleep_for(chrono::milliseconds(40));
+
+			alive++;
+		}
+
+		~Session()
+		{
+			alive--;
+		}
+
+		void reset()
+		{
+			requests = 0;
+		}
+
+		void handle()
+		{
+			requests++;
+
+			this_thread::sleep_for(chrono::milliseconds(20));
+		}
+
+		static atomic<int> alive;
+
+	private:
+
+		int requests;
+};
+
+atomic<int> Session::alive(0);
+
+typedef BoundedObjectPool<Session> SessionPool;
+
+
+// Client - handles one request with a pooled session.
+void client(SessionPool * pool)
+{
+	SessionPool::lease_type session = pool->acquire();
+
+	session->handle();
+}
+
+// Runs n clients at the same time and reports how long it took.
+void burst(SessionPool & pool, int n)
+{
+	vector<thread> clients;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for (int i = 0; i < n; i++)
+	{
+		clients.push_back(thread(client, &pool));
+	}
+
+	for (size_t i = 0; i < clients.size(); i++)
+	{
+		clients[i].join();
+	}
+
+	chrono::milliseconds elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+
+	cout << "burst of " << n << " clients took " << elapsed.count() << " ms, pool holds " << pool.size() << " sessions" << endl;
+}
+
+
+int main()
+{
+	// Keep 4 sessions ready, let the pool grow to 16 under load, and shrink back to
+	// 6 sessions once the extra ones have been idle for 100 ms.
+	SessionPool pool(16, PoolWatermarks(4, 6, chrono::milliseconds(100)));
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	// Build the 4 sessions on 4 threads, which takes about as long as building one.
+	pool.prefill(4, 4);
+
+	chrono::milliseconds elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+
+	cout << "prefilled " << pool.size() << " sessions in " << elapsed.count() << " ms" << endl;
+
+	// These clients find their sessions ready.
+	burst(pool, 4);
+
+	// A burst grows the pool.
+	burst(pool, 12);
+
+	pool.start_trimmer(chrono::milliseconds(50));
+
+	this_thread::sleep_for(chrono::milliseconds(300));
+
+	cout << "after the trimmer ran the pool holds " << pool.size() << " sessions, " << Session::alive << " alive" << endl;
+
+	pool.stop_trimmer();
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the timings will vary):
+/*
+prefilled 4 sessions in 40 ms
+burst of 4 clients took 20 ms, pool holds 4 sessions
+burst of 12 clients took 61 ms, pool holds 12 sessions
+after the trimmer ran the pool holds 6 sessions, 6 alive
+*/
@@ -0,0 +1,155 @@
+// Object Pool Design Pattern - Creational Category
+
+// Object Pool with generational handles.
+
+// The pool in Object_Pool.cpp hands out raw Resource pointers. A client that keeps its pointer after
+// returnResource() silently reads and writes the Resource of whichever client gets it next, and every
+// structure that refers to pooled objects pays 8 bytes per reference.
+
+// HandlePool in ObjectPool.h hands out 4-byte PoolHandles instead: the index of the object's slot
+// plus the generation of the slot. Returning an object bumps the generation of its slot, so a stale
+// handle no longer resolves. Looking a handle up is an O(1) index into the pool's slabs followed by
+// one comparison.
+
+// http://en.wikipedia.org/wiki/Object_pool_pattern
+// http://en.wikipedia.org/wiki/Dangling_pointer
+
+#include <chrono>
+#include <vector>
+#include <iostream>
+
+#include "ObjectPool.h"
+
+using namespace std;
+
+// Resource - wraps the limited reusable resource which will be shared by several clients for a limited amount of time.
+class Resource
+{
+	public:
+
+		Resource()
+		{
+			value = 0;
+		}
+
+		void reset()
+		{
+			value = 0;
+		}
+
+		int getValue()
+		{
+			return value;
+		}
+
+		void setValue(int val)
+		{
+			value = val;
+		}
+
+	private:
+
+		int value;
+};
+
+
+int main()
+{
+	HandlePool<Resource> pool;
+
+	PoolHandle h1 = pool.acquire();
+	pool.resolve(h1)->setValue(10);
+	cout << "h1 = " << pool.resolve(h1)->getValue() << " [" << hex << h1.value << dec << "]" << endl;
+
+	// Return the resource but keep the handle around.
+	pool.release(h1);
+
+	// The next client gets the same slot with a new generation.
+	PoolHandle h2 = pool.acquire();
+	pool.resolve(h2)->setValue(20);
+	cout << "h2 = " << pool.resolve(h2)->getValue() << " [" << hex << h2.value << dec << "]" << endl;
+
+	// The stale handle is detected instead of aliasing the new client's resource.
+	cout << "h1 " << (pool.valid(h1) ? "still resolves" : "is stale") << endl;
+	cout << "second release of h1 " << (pool.release(h1) ? "accepted" : "rejected") << endl;
+
+	pool.release(h2);
+
+	// A structure that refers to many pooled objects, once by pointer and once by handle.
+	const int objects = 1 << 16;
+	const int references = 1 << 22;
+
+	HandlePool<Resource> big;
+	vector<PoolHandle> handles;
+	vector<Resource *> pointers;
+
+	for (int i = 0; i < objects; i++)
+	{
+		handles.push_back(big.acquire());
+		pointers.push_back(big.resolve(handles.back()));
+		pointers.back()->setValue(i & 7);
+	}
+
+	vector<PoolHandle> handleRefs;
+	vector<Resource *> pointerRefs;
+
+	for (int i = 0; i < references; i++)
+	{
+		unsigned j = (static_cast<unsigned>(i) * 7919u) & (objects - 1);
+
+		handleRefs.push_back(handles[j]);
+		pointerRefs.push_back(pointers[j]);
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	long long sum = 0;
+
+	for (int i = 0; i < references; i++)
+	{
+		sum += pointerRefs[i]->getValue();
+	}
+
+	chrono::duration<double, milli> pointerTime = chrono::steady_clock::now() - start;
+
+	start = chrono::steady_clock::now();
+
+	long long checkedSum = 0;
+
+	for (int i = 0; i < references; i++)
+	{
+		Resource * resource = big.resolve(handleRefs[i]);
+
+		if (resource != NULL)
+		{
+			checkedSum += resource->getValue();
+		}
+	}
+
+	chrono::duration<double, milli> handleTime = chrono::steady_clock::now() - start;
+
+	cout << endl << references << " references" << endl;
+	cout << "pointers: " << pointerRefs.size() * sizeof(Resource *) / 1024 << " KB, sum " << sum << ", " << pointerTime.count() << " ms" << endl;
+	cout << "handles:  " << handleRefs.size() * sizeof(PoolHandle) / 1024 << " KB, sum " << checkedSum << ", " << handleTime.count() << " ms (checked)" << endl;
+
+	for (int i = 0; i < objects; i++)
+	{
+		big.release(handles[i]);
+	}
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the timings will vary):
+/*
+h1 = 10 [100000]
+h2 = 20 [200000]
+h1 is stale
+second release of h1 rejected
+
+4194304 references
+pointers: 32768 KB, sum 14680064, 4.1 ms
+handles:  16384 KB, sum 14680064, 6.3 ms (checked)
+*/
@@ -0,0 +1,180 @@
+// Object Pool Design Pattern - Creational Category
+
+// Object Pool for variable-size buffers.
+
+// The objects that are pooled most often are not fixed Resources but byte buffers whose size
+// depends on the data: network packets, records read from a file, and so on. BufferPool in
+// BufferPool.h applies the design of Object_Pool.cpp to them - slabs and intrusive free lists -
+// with one free list per power-of-two size class and a fallback for oversize requests.
+
+// The benchmark below simulates an ingest loop: buffers of mixed sizes are received, held for a while
+// and released, with a window of live buffers. It compares BufferPool against malloc / free and
+// against std::pmr::unsynchronized_pool_resource, which is built on the same idea.
+
+// http://en.wikipedia.org/wiki/Object_pool_pattern
+// http://en.cppreference.com/w/cpp/memory/unsynchronized_pool_resource
+
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory_resource>
+
+#include "BufferPool.h"
+
+using namespace std;
+
+// Simulated message sizes: mostly small packets, some jumbo frames, a few large blobs.
+vector<size_t> messageSizes(size_t count)
+{
+	vector<size_t> sizes;
+	unsigned seed = 12345;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		unsigned r = (seed >> 8) % 1000;
+
+		if (r < 900)
+		{
+			sizes.push_back(64 + r * 3 / 2);			// 64 .. 1414 bytes
+		}
+		else if (r < 990)
+		{
+			sizes.push_back(9000);						// jumbo frame
+		}
+		else if (r < 999)
+		{
+			sizes.push_back(256 * 1024);				// large blob
+		}
+		else
+		{
+			sizes.push_back(4 * 1024 * 1024);			// oversize
+		}
+	}
+
+	return sizes;
+}
+
+// Every buffer stays live while the next window buffers are received.
+template <class Allocate, class Deallocate>
+double ingest(const vector<size_t> & sizes, size_t window, Allocate allocate, Deallocate deallocate)
+{
+	vector<char *> live(window, static_cast<char *>(NULL));
+	vector<size_t> liveSize(window, 0);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	for (size_t i = 0; i < sizes.size(); i++)
+	{
+		size_t slot = i % window;
+
+		if (live[slot] != NULL)
+		{
+			deallocate(live[slot], liveSize[slot]);
+		}
+
+		live[slot] = static_cast<char *>(allocate(sizes[i]));
+		liveSize[slot] = sizes[i];
+
+		// "Receive" a header.
+		memset(live[slot], static_cast<int>(i), 64);
+	}
+
+	for (size_t slot = 0; slot < window; slot++)
+	{
+		if (live[slot] != NULL)
+		{
+			deallocate(live[slot], liveSize[slot]);
+		}
+	}
+
+	chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
+
+	return elapsed.count() / sizes.size();
+}
+
+
+int main()
+{
+	BufferPool pool;
+
+	// Small requests share a size class, the buffer handed out is a power of two.
+	void * a = pool.allocate(100);
+	void * b = pool.allocate(120);
+
+	cout << "100 bytes -> " << BufferPool::capacity(100) << " byte buffer [" << a << "]" << endl;
+	cout << "120 bytes -> " << BufferPool::capacity(120) << " byte buffer [" << b << "]" << endl;
+
+	pool.deallocate(a, 100);
+
+	// The freed buffer is reused for the next request of the same class.
+	void * c = pool.allocate(128);
+
+	cout << "128 bytes -> " << BufferPool::capacity(128) << " byte buffer [" << c << "]" << endl;
+
+	pool.deallocate(b, 120);
+	pool.deallocate(c, 128);
+
+	const size_t messages = 2000000;
+	const size_t window = 256;
+
+	vector<size_t> sizes = messageSizes(messages);
+
+	cout << endl << messages << " messages, " << window << " live at a time" << endl;
+
+	double mallocTime = ingest(sizes, window,
+		[](size_t bytes) { return malloc(bytes); },
+		[](void * p, size_t) { free(p); });
+
+	cout << "malloc / free:                " << mallocTime << " ns per message" << endl;
+
+	{
+		pmr::unsynchronized_pool_resource resource;
+
+		double pmrTime = ingest(sizes, window,
+			[&resource](size_t bytes) { return resource.allocate(bytes); },
+			[&resource](void * p, size_t bytes) { resource.deallocate(p, bytes); });
+
+		cout << "unsynchronized_pool_resource: " << pmrTime << " ns per message" << endl;
+	}
+
+	{
+		BufferPool buffers;
+
+		double poolTime = ingest(sizes, window,
+			[&buffers](size_t bytes) { return buffers.allocate(bytes); },
+			[&buffers](void * p, size_t bytes) { buffers.deallocate(p, bytes); });
+
+		cout << "BufferPool:                   " << poolTime << " ns per message" << endl;
+	}
+
+	{
+		BufferPool buffers(true);
+
+		double hugeTime = ingest(sizes, window,
+			[&buffers](size_t bytes) { return buffers.allocate(bytes); },
+			[&buffers](void * p, size_t bytes) { buffers.deallocate(p, bytes); });
+
+		cout << "BufferPool (huge pages):      " << hugeTime << " ns per message" << endl;
+	}
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the addresses and timings will vary):
+/*
+100 bytes -> 128 byte buffer [0x7f4c5e5fe010]
+120 bytes -> 128 byte buffer [0x7f4c5e5fe090]
+128 bytes -> 128 byte buffer [0x7f4c5e5fe010]
+
+2000000 messages, 256 live at a time
+malloc / free:                ...
+unsynchronized_pool_resource: ...
+BufferPool:                   ...
+BufferPool (huge pages):      ...
+*/
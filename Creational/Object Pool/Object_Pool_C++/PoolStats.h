@@ -0,0 +1,293 @@
+
+//************************************************************************/
+//* PoolStats.h                                                          */
+//************************************************************************/
+
+// Instrumentation for object pools.
+
+// PoolStats counts hits (an object was reused), misses (an object had to be created), returns,
+// the number of objects currently in use and free, and the peak number in use. The counters are
+// relaxed atomics: updating one costs about as much as an ordinary increment, yet another thread
+// can read them at any time without a lock. The figures are only approximately consistent with
+// each other while the pool is busy.
+
+// LatencyHistogram records how long acquiring an object took, in nanoseconds, with the layout used
+// by HDR histograms: every power of two is split into 16 linear sub-buckets, so any value is known
+// within about 6% over the whole 64-bit range, with 976 fixed counters and no allocation.
+
+// Both can be dumped on demand as text or as JSON.
+
+// http://hdrhistogram.org
+
+#ifndef MY_POOLSTATS_HEADER
+#define MY_POOLSTATS_HEADER
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+class LatencyHistogram
+{
+	public:
+
+		static const unsigned SubBucketBits = 4;
+		static const unsigned SubBuckets = 1u << SubBucketBits;
+		static const unsigned Buckets = (64 - SubBucketBits + 1) * SubBuckets;
+
+		LatencyHistogram()
+		{
+			for (unsigned i = 0; i < Buckets; i++)
+			{
+				counts[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		void record(std::uint64_t nanoseconds)
+		{
+			counts[bucketOf(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+		}
+
+		std::uint64_t count() const
+		{
+			std::uint64_t total = 0;
+
+			for (unsigned i = 0; i < Buckets; i++)
+			{
+				total += counts[i].load(std::memory_order_relaxed);
+			}
+
+			return total;
+		}
+
+		// Upper bound of the bucket holding the given fraction (0 to 1) of the recorded values.
+		std::uint64_t percentile(double fraction) const
+		{
+			std::uint64_t total = count();
+			std::uint64_t wanted = static_cast<std::uint64_t>(fraction * total + 0.5);
+			std::uint64_t seen = 0;
+
+			if (wanted == 0)
+			{
+				wanted = 1;
+			}
+
+			for (unsigned i = 0; i < Buckets; i++)
+			{
+				seen += counts[i].load(std::memory_order_relaxed);
+
+				if (seen >= wanted)
+				{
+					return upperBound(i);
+				}
+			}
+
+			return 0;
+		}
+
+		void writeText(std::ostream & out) const
+		{
+			out << "acquire latency (ns): count " << count()
+				<< ", p50 " << percentile(0.5) << ", p90 " << percentile(0.9)
+				<< ", p99 " << percentile(0.99) << ", p99.9 " << percentile(0.999)
+				<< ", max " << percentile(1.0) << "\n";
+
+			for (unsigned i = 0; i < Buckets; i++)
+			{
+				std::uint64_t n = counts[i].load(std::memory_order_relaxed);
+
+				if (n != 0)
+				{
+					out << "  [" << lowerBound(i) << ", " << upperBound(i) << "] " << n << "\n";
+				}
+			}
+		}
+
+		void writeJson(std::ostream & out) const
+		{
+			out << "{\"count\":" << count()
+				<< ",\"p50\":" << percentile(0.5) << ",\"p90\":" << percentile(0.9)
+				<< ",\"p99\":" << percentile(0.99) << ",\"p999\":" << percentile(0.999)
+				<< ",\"max\":" << percentile(1.0) << ",\"buckets\":[";
+
+			bool first = true;
+
+			for (unsigned i = 0; i < Buckets; i++)
+			{
+				std::uint64_t n = counts[i].load(std::memory_order_relaxed);
+
+				if (n != 0)
+				{
+					out << (first ? "" : ",") << "[" << lowerBound(i) << "," << upperBound(i) << "," << n << "]";
+					first = false;
+				}
+			}
+
+			out << "]}";
+		}
+
+	private:
+
+		LatencyHistogram(const LatencyHistogram &); // not allowed
+		LatencyHistogram & operator=(const LatencyHistogram &); // not allowed
+
+		static unsigned highestBit(std::uint64_t value)
+		{
+#if defined(__GNUC__)
+			return 63 - __builtin_clzll(value);
+#else
+			unsigned bit = 0;
+
+			while (value >>= 1)
+			{
+				bit++;
+			}
+
+			return bit;
+#endif
+		}
+
+		// Values below SubBuckets get a bucket each. Above that, the highest set bit selects the
+		// power of two and the next SubBucketBits bits select the sub-bucket.
+		static unsigned bucketOf(std::uint64_t value)
+		{
+			if (value < SubBuckets)
+			{
+				return static_cast<unsigned>(value);
+			}
+
+			unsigned msb = highestBit(value);
+			unsigned shift = msb - SubBucketBits;
+
+			return (shift + 1) * SubBuckets + static_cast<unsigned>((value >> shift) & (SubBuckets - 1));
+		}
+
+		static std::uint64_t lowerBound(unsigned bucket)
+		{
+			if (bucket < SubBuckets)
+			{
+				return bucket;
+			}
+
+			unsigned shift = bucket / SubBuckets - 1;
+
+			return static_cast<std::uint64_t>(SubBuckets + bucket % SubBuckets) << shift;
+		}
+
+		static std::uint64_t upperBound(unsigned bucket)
+		{
+			if (bucket < SubBuckets)
+			{
+				return bucket;
+			}
+
+			unsigned shift = bucket / SubBuckets - 1;
+
+			return lowerBound(bucket) + ((static_cast<std::uint64_t>(1) << shift) - 1);
+		}
+
+		std::atomic<std::uint64_t> counts[Buckets];
+};
+
+class PoolStats
+{
+	public:
+
+		PoolStats() : hitCount(0), missCount(0), returnCount(0), inUseCount(0), peakInUseCount(0), freeCount(0)
+		{
+		}
+
+		// An object was taken from the free list.
+		void hit()
+		{
+			hitCount.fetch_add(1, std::memory_order_relaxed);
+			freeCount.fetch_sub(1, std::memory_order_relaxed);
+			acquired();
+		}
+
+		// A new object had to be created.
+		void miss()
+		{
+			missCount.fetch_add(1, std::memory_order_relaxed);
+			acquired();
+		}
+
+		// An object was put back on the free list.
+		void returned()
+		{
+			returnCount.fetch_add(1, std::memory_order_relaxed);
+			inUseCount.fetch_sub(1, std::memory_order_relaxed);
+			freeCount.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		void acquireLatency(std::chrono::steady_clock::duration elapsed)
+		{
+			latency.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+		}
+
+		std::uint64_t hits() const { return hitCount.load(std::memory_order_relaxed); }
+		std::uint64_t misses() const { return missCount.load(std::memory_order_relaxed); }
+		std::uint64_t returns() const { return returnCount.load(std::memory_order_relaxed); }
+		std::int64_t inUse() const { return inUseCount.load(std::memory_order_relaxed); }
+		std::int64_t peakInUse() const { return peakInUseCount.load(std::memory_order_relaxed); }
+		std::int64_t available() const { return freeCount.load(std::memory_order_relaxed); }
+
+		double hitRate() const
+		{
+			std::uint64_t total = hits() + misses();
+
+			return total == 0 ? 0.0 : static_cast<double>(hits()) / total;
+		}
+
+		const LatencyHistogram & acquireLatencies() const
+		{
+			return latency;
+		}
+
+		void writeText(std::ostream & out) const
+		{
+			out << "hits " << hits() << ", misses " << misses() << ", hit rate " << hitRate()
+				<< ", returns " << returns() << ", in use " << inUse() << ", peak in use " << peakInUse()
+				<< ", free " << available() << "\n";
+
+			latency.writeText(out);
+		}
+
+		void writeJson(std::ostream & out) const
+		{
+			out << "{\"hits\":" << hits() << ",\"misses\":" << misses() << ",\"hitRate\":" << hitRate()
+				<< ",\"returns\":" << returns() << ",\"inUse\":" << inUse() << ",\"peakInUse\":" << peakInUse()
+				<< ",\"free\":" << available() << ",\"acquireLatencyNs\":";
+
+			latency.writeJson(out);
+
+			out << "}";
+		}
+
+	private:
+
+		PoolStats(const PoolStats &); // not allowed
+		PoolStats & operator=(const PoolStats &); // not allowed
+
+		void acquired()
+		{
+			std::int64_t now = inUseCount.fetch_add(1, std::memory_order_relaxed) + 1;
+			std::int64_t peak = peakInUseCount.load(std::memory_order_relaxed);
+
+			// Only writes when a new peak is reached, which is rare once the pool has warmed up.
+			while (now > peak && !peakInUseCount.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		std::atomic<std::uint64_t> hitCount;
+		std::atomic<std::uint64_t> missCount;
+		std::atomic<std::uint64_t> returnCount;
+		std::atomic<std::int64_t> inUseCount;
+		std::atomic<std::int64_t> peakInUseCount;
+		std::atomic<std::int64_t> freeCount;
+
+		LatencyHistogram latency;
+};
+
+#endif
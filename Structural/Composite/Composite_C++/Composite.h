@@ -0,0 +1,387 @@
+
+//************************************************************************/
+//* Composite.h                                                          */
+//************************************************************************/
+
+// The Component, Leaf and Composite classes of Composite1.cpp, shared by the Composite samples,
+// and FrozenComposite, a read-only copy of a composite laid out for fast traversal.
+
+// A Composite does not own its children: the same component may be added to several composites,
+// so a composite is really a directed acyclic graph. traverse() and sum() walk a shared component
+// once for every path that leads to it, and never return if a composite has been added below itself.
+// MemoizedEvaluation evaluates a shared composite once per pass and stops at the first cycle.
+
+// http://sourcemaking.com/design_patterns/composite/cpp/1
+
+#ifndef MY_COMPOSITE_HEADER
+#define MY_COMPOSITE_HEADER
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <ostream>
+#include <iostream>
+#include <exception>
+#include <unordered_map>
+#include <unordered_set>
+
+// 2. Create an "interface" (lowest common denominator)
+class Component
+{
+	public:
+
+		virtual ~Component() { }
+
+		virtual void traverse(std::ostream & out = std::cout) = 0;
+
+		// Sum of the values of all the leaves.
+		virtual long long sum() = 0;
+};
+
+// 1. Scalar class
+// 3. "is a" relationship
+class Leaf : public Component
+{
+	int value;
+
+	public:
+
+		Leaf(int val)
+		{
+			value = val;
+		}
+
+		void traverse(std::ostream & out = std::cout)
+		{
+			out << value << ' ';
+		}
+
+		long long sum()
+		{
+			return value;
+		}
+
+		int getValue() const
+		{
+			return value;
+		}
+};
+
+// 1. Vector class
+// 3. "is a" relationship
+class Composite : public Component
+{
+	// 4. "container" coupled to the interface
+	std::vector <Component *> children;
+
+	public:
+
+		// 4. "container" class coupled to the interface
+		void add(Component * ele)
+		{
+			children.push_back(ele);
+		}
+
+		void traverse(std::ostream & out = std::cout)
+		{
+			for (std::size_t i = 0; i < children.size(); i++)
+
+				// 5. Use polymorphism to delegate to children
+				children[i]->traverse(out);
+		}
+
+		long long sum()
+		{
+			long long total = 0;
+
+			for (std::size_t i = 0; i < children.size(); i++)
+			{
+				total += children[i]->sum();
+			}
+
+			return total;
+		}
+
+		std::size_t size() const
+		{
+			return children.size();
+		}
+
+		Component * child(std::size_t i) const
+		{
+			return children[i];
+		}
+};
+
+
+class CycleException : public std::exception
+{
+	private:
+
+		std::string s;
+
+	public:
+
+		CycleException(std::string ss) : s(ss) { }
+		~CycleException() throw () { }
+		const char * what() const throw() { return s.c_str(); }
+};
+
+// Evaluates an aggregate over a composite, computing each composite only once per pass.
+
+// evaluate(root, empty, leaf, combine) returns the result of the whole tree, where the result of
+// a leaf is leaf(value) and the result of a composite is combine() folded over its children:
+// combine(combine(empty, first child), second child) ... The results are the ones a plain
+// recursive walk would compute, shared subtrees counted once per path, but a composite that is
+// reached again is not walked again: its result is remembered for the rest of the pass. A DAG
+// whose composites each hold the previous one twice has 2^depth paths but is evaluated in O(depth).
+// The walk uses its own stack, so deep trees cannot overflow the call stack, and a composite met
+// again while it is still being evaluated is a cycle: evaluate() throws CycleException at once.
+template <class Result>
+class MemoizedEvaluation
+{
+	public:
+
+		MemoizedEvaluation() : evaluatedCount(0), reusedCount(0)
+		{
+		}
+
+		template <class LeafFunction, class Combine>
+		Result evaluate(Component & root, Result empty, LeafFunction leaf, Combine combine)
+		{
+			done.clear();
+			evaluatedCount = 0;
+			reusedCount = 0;
+
+			Composite * composite = dynamic_cast<Composite *>(&root);
+
+			if (composite == NULL)
+			{
+				return leaf(static_cast<Leaf &>(root).getValue());
+			}
+
+			std::vector<Frame> stack;
+			std::unordered_set<const Composite *> open;
+
+			Frame first = { composite, 0, empty };
+			stack.push_back(first);
+			open.insert(composite);
+
+			while (true)
+			{
+				Frame & top = stack.back();
+
+				if (top.next == top.composite->size())
+				{
+					// All the children are in: the composite is done.
+					Result result = top.result;
+
+					done[top.composite] = result;
+					open.erase(top.composite);
+					evaluatedCount++;
+					stack.pop_back();
+
+					if (stack.empty())
+					{
+						return result;
+					}
+
+					stack.back().result = combine(stack.back().result, result);
+
+					continue;
+				}
+
+				Component * child = top.composite->child(top.next++);
+				Composite * inner = dynamic_cast<Composite *>(child);
+
+				if (inner == NULL)
+				{
+					top.result = combine(top.result, leaf(static_cast<Leaf *>(child)->getValue()));
+				}
+				else if (done.count(inner) != 0)
+				{
+					top.result = combine(top.result, done[inner]);
+					reusedCount++;
+				}
+				else if (open.count(inner) != 0)
+				{
+					throw CycleException("Composite contains itself.");
+				}
+				else
+				{
+					Frame frame = { inner, 0, empty };
+
+					open.insert(inner);
+					stack.push_back(frame);		// top is invalid from here on.
+				}
+			}
+		}
+
+		// Composites evaluated by the last pass, and results of composites reused by it.
+		std::size_t evaluated() const
+		{
+			return evaluatedCount;
+		}
+
+		std::size_t reused() const
+		{
+			return reusedCount;
+		}
+
+	private:
+
+		struct Frame
+		{
+			Composite * composite;
+			std::size_t next;	// Next child to evaluate.
+			Result result;		// Children evaluated so far, combined.
+		};
+
+		std::unordered_map<const Composite *, Result> done;
+		std::size_t evaluatedCount;
+		std::size_t reusedCount;
+};
+
+// A composite "frozen" into one contiguous array.
+
+// Walking a Composite means a virtual call and a pointer chase to a separately allocated object for
+// every node, in whatever order the allocator happened to place them. Trees that are built once and
+// then read many times can be compiled into an array of FrozenNodes in preorder: every node is
+// followed by its whole subtree, and stores the size of that subtree, so
+// - the leaves of any subtree are read by a linear scan of its entries, which the hardware
+//   prefetcher streams in, with no virtual call and no recursion;
+// - the children of node i start at i + 1, and the next sibling of node j is at j + subtree size.
+// A component that has been added under several parents is copied under each of them, so the
+// frozen tree traverses exactly like the original. Later changes to the original are not seen.
+// The composite must not contain a cycle, see MemoizedEvaluation.
+class FrozenComposite
+{
+	public:
+
+		enum Kind { LeafNode, CompositeNode };
+
+		struct FrozenNode
+		{
+			std::int32_t value;			// Leaves only.
+			std::uint32_t subtree;		// Number of entries of the subtree, the node included.
+			std::uint8_t kind;
+		};
+
+		explicit FrozenComposite(Component & root) : leafCount(0)
+		{
+			// Preorder without recursion: the stack holds the composites whose children are being copied.
+			std::vector<Open> stack;
+
+			append(&root, stack);
+
+			while (!stack.empty())
+			{
+				Open & top = stack.back();
+
+				if (top.next < top.composite->size())
+				{
+					append(top.composite->child(top.next++), stack);
+				}
+				else
+				{
+					nodes[top.entry].subtree = static_cast<std::uint32_t>(nodes.size() - top.entry);
+					stack.pop_back();
+				}
+			}
+		}
+
+		// Prints the leaves of the subtree rooted at entry first, like Component::traverse().
+		void traverse(std::ostream & out = std::cout, std::size_t first = 0) const
+		{
+			std::size_t last = first + nodes[first].subtree;
+
+			for (std::size_t i = first; i < last; i++)
+			{
+				if (nodes[i].kind == LeafNode)
+				{
+					out << nodes[i].value << ' ';
+				}
+			}
+		}
+
+		long long sum(std::size_t first = 0) const
+		{
+			std::size_t last = first + nodes[first].subtree;
+			long long total = 0;
+
+			for (std::size_t i = first; i < last; i++)
+			{
+				// Composites hold 0, so they need not be skipped.
+				total += nodes[i].value;
+			}
+
+			return total;
+		}
+
+		// Calls visit(int) with the value of every leaf of the subtree, in order.
+		template <class Visitor>
+		void visit(Visitor & visitor, std::size_t first = 0) const
+		{
+			std::size_t last = first + nodes[first].subtree;
+
+			for (std::size_t i = first; i < last; i++)
+			{
+				if (nodes[i].kind == LeafNode)
+				{
+					visitor(nodes[i].value);
+				}
+			}
+		}
+
+		const FrozenNode & node(std::size_t i) const
+		{
+			return nodes[i];
+		}
+
+		// Number of entries: leaves and composites.
+		std::size_t size() const
+		{
+			return nodes.size();
+		}
+
+		std::size_t leaves() const
+		{
+			return leafCount;
+		}
+
+	private:
+
+		struct Open
+		{
+			Composite * composite;
+			std::size_t next;		// Next child to copy.
+			std::size_t entry;		// Index of the composite's own entry.
+		};
+
+		// Every Component is either a Leaf or a Composite.
+		void append(Component * component, std::vector<Open> & stack)
+		{
+			FrozenNode node = { 0, 1, LeafNode };
+			Composite * composite = dynamic_cast<Composite *>(component);
+
+			if (composite != NULL)
+			{
+				node.kind = CompositeNode;
+
+				Open open = { composite, 0, nodes.size() };
+				stack.push_back(open);
+			}
+			else
+			{
+				node.value = static_cast<Leaf *>(component)->getValue();
+				leafCount++;
+			}
+
+			nodes.push_back(node);
+		}
+
+		std::vector<FrozenNode> nodes;
+		std::size_t leafCount;
+};
+
+#endif
@@ -1,87 +1,356 @@
 // Composite Design Pattern - Structural Category
 
-// Composite pattern lets clients treat individual objects and compositions of objects uniformly. 
-// The Composite pattern can represent both conditions. 
+// Composite pattern lets clients treat individual objects and compositions of objects uniformly.
+// The Composite pattern can represent both conditions.
 // In this pattern, one can develop tree structures for representing part-whole hierarchies.
 
+// CompositeGraphic processes its children through one virtual call each, and in a scene of mixed
+// shapes the next call goes to Ellipse, Square or Circle at random, which the CPU cannot predict.
+// GraphicScene is a data-oriented copy of a composite for scenes of millions of primitives:
+// - the data of each kind of primitive is stored in a contiguous array of its own, and
+// - the order of the primitives is kept as a list of runs: so many ellipses, then so many squares...,
+//   with markers where a nested composite begins and ends.
+// area() walks the runs and sums each run in one batch, a plain loop over the array of its kind with
+// no virtual call and no allocation. The sums are made in the order and with the nesting of the
+// composite, so the result is identical to CompositeGraphic::area(), floating point rounding included.
+// print() writes each run in one go. Graphics of any other class, including classes derived from the
+// primitives, are kept as pointers and reached through their virtual functions, as in the composite.
+// Runs form where drawings put shapes of a kind together, e.g. in layers; the benchmark builds such a scene.
+
 // http://en.wikibooks.org/wiki/C%2B%2B_Programming/Code/Design_Patterns/Structural_Patterns#Composite
+// http://en.wikipedia.org/wiki/Data-oriented_design
 
+#include <chrono>
 #include <vector>
-#include <memory>		// std::auto_ptr
+#include <memory>		// std::unique_ptr
+#include <typeinfo>
+#include <sstream>
+#include <iomanip>
 #include <iostream>		// std::cout
 #include <algorithm>	// std::for_each
-#include <functional>	// std::mem_fun
+#include <functional>	// std::mem_fn
 
 using namespace std;
- 
+
 class Graphic
 {
 	public:
 
 		virtual ~Graphic() { }
 		virtual void print() const = 0;
+		virtual double area() const = 0;
 };
- 
+
 class Ellipse : public Graphic
 {
 	public:
+		Ellipse(double a = 1.0, double b = 1.0) : a(a), b(b) { }
 		void print() const { cout << "Ellipse \n"; }
+		double area() const { return 3.14159265358979 * a * b; }
+
+		double a, b;	// Semi-axes.
 };
 
 class Square : public Graphic
 {
 	public:
+		Square(double side = 1.0) : side(side) { }
 		void print() const { cout << "Square \n"; }
+		double area() const { return side * side; }
+
+		double side;
 };
 
 class Circle : public Graphic
 {
 	public:
+		Circle(double radius = 1.0) : radius(radius) { }
 		void print() const { cout << "Circle \n"; }
+		double area() const { return 3.14159265358979 * radius * radius; }
+
+		double radius;
 };
- 
+
 class CompositeGraphic : public Graphic
 {
 	public:
-	
-		void print() const 
+
+		void print() const
 		{
 			// for each element in graphic_list, call the print member function
-			for_each(graphic_list.begin(), graphic_list.end(), mem_fun(&Graphic::print));
+			for_each(graphic_list.begin(), graphic_list.end(), mem_fn(&Graphic::print));
 		}
- 
-		void add(Graphic * aGraphic) 
+
+		double area() const
+		{
+			double total = 0;
+
+			for (size_t i = 0; i < graphic_list.size(); i++)
+			{
+				total += graphic_list[i]->area();
+			}
+
+			return total;
+		}
+
+		void add(Graphic * aGraphic)
 		{
 			graphic_list.push_back(aGraphic);
 		}
- 
+
+		const vector<Graphic *> & children() const
+		{
+			return graphic_list;
+		}
+
 	private:
 
 		vector<Graphic *>  graphic_list;
 };
- 
+
+// A composite graphic with the primitives bucketed by kind.
+class GraphicScene
+{
+	public:
+
+		explicit GraphicScene(const Graphic & root)
+		{
+			append(root, true);
+		}
+
+		void print() const
+		{
+			size_t next = 0;
+
+			for (size_t r = 0; r < runs.size(); r++)
+			{
+				if (runs[r].kind == OtherKind)
+				{
+					for (size_t i = 0; i < runs[r].count; i++)
+					{
+						others[next++]->print();
+					}
+				}
+				else if (runs[r].kind < PrimitiveKinds)
+				{
+					// print() uses no state of the primitives: the run prints the same line count times.
+					const char * text = names[runs[r].kind];
+
+					for (size_t i = 0; i < runs[r].count; i++)
+					{
+						cout << text;
+					}
+				}
+			}
+		}
+
+		double area() const
+		{
+			size_t r = 0;
+			size_t next[KindCount] = { 0, 0, 0, 0 };
+
+			return area(r, next);
+		}
+
+		size_t primitives() const
+		{
+			return ellipses.size() + squares.size() + circles.size() + others.size();
+		}
+
+		// Runs of primitives and group markers.
+		size_t runCount() const
+		{
+			return runs.size();
+		}
+
+	private:
+
+		enum Kind { EllipseKind, SquareKind, CircleKind, PrimitiveKinds, OtherKind = PrimitiveKinds, KindCount, GroupBegin = KindCount, GroupEnd };
+
+		struct EllipseData
+		{
+			double a, b;
+		};
+
+		// count consecutive primitives of one kind, or the beginning or end of a nested composite.
+		struct Run
+		{
+			Kind kind;
+			size_t count;
+		};
+
+		static const char * const names[PrimitiveKinds];
+
+		// Sums the runs from r to the end of the group r is in, next holding the position in the array of
+		// each kind; returns with r past the end of the group.
+		double area(size_t & r, size_t next[]) const
+		{
+			double total = 0;
+
+			while (r < runs.size())
+			{
+				const Run & run = runs[r++];
+
+				if (run.kind == GroupBegin)
+				{
+					total += area(r, next);
+					continue;
+				}
+
+				if (run.kind == GroupEnd)
+				{
+					return total;
+				}
+
+				size_t first = next[run.kind], last = first + run.count;
+
+				switch (run.kind)
+				{
+					case EllipseKind:
+						for (size_t i = first; i < last; i++)
+						{
+							total += 3.14159265358979 * ellipses[i].a * ellipses[i].b;
+						}
+						break;
+
+					case SquareKind:
+						for (size_t i = first; i < last; i++)
+						{
+							total += squares[i] * squares[i];
+						}
+						break;
+
+					case CircleKind:
+						for (size_t i = first; i < last; i++)
+						{
+							total += 3.14159265358979 * circles[i] * circles[i];
+						}
+						break;
+
+					default:
+						for (size_t i = first; i < last; i++)
+						{
+							total += others[i]->area();
+						}
+						break;
+				}
+
+				next[run.kind] = last;
+			}
+
+			return total;
+		}
+
+		void append(const Graphic & graphic, bool root = false)
+		{
+			// Only the exact classes: a derived class may override area() or print().
+			const type_info & type = typeid(graphic);
+
+			if (type == typeid(CompositeGraphic))
+			{
+				const CompositeGraphic * composite = static_cast<const CompositeGraphic *>(&graphic);
+				const vector<Graphic *> & children = composite->children();
+
+				if (!root)
+				{
+					Run begin = { GroupBegin, 0 };
+					runs.push_back(begin);
+				}
+
+				for (size_t i = 0; i < children.size(); i++)
+				{
+					append(*children[i]);
+				}
+
+				if (!root)
+				{
+					Run end = { GroupEnd, 0 };
+					runs.push_back(end);
+				}
+			}
+			else if (type == typeid(Ellipse))
+			{
+				const Ellipse * ellipse = static_cast<const Ellipse *>(&graphic);
+				EllipseData data = { ellipse->a, ellipse->b };
+
+				ellipses.push_back(data);
+				extend(EllipseKind);
+			}
+			else if (type == typeid(Square))
+			{
+				squares.push_back(static_cast<const Square &>(graphic).side);
+				extend(SquareKind);
+			}
+			else if (type == typeid(Circle))
+			{
+				circles.push_back(static_cast<const Circle &>(graphic).radius);
+				extend(CircleKind);
+			}
+			else
+			{
+				others.push_back(&graphic);
+				extend(OtherKind);
+			}
+		}
+
+		void extend(Kind kind)
+		{
+			if (!runs.empty() && runs.back().kind == kind)
+			{
+				runs.back().count++;
+			}
+			else
+			{
+				Run run = { kind, 1 };
+				runs.push_back(run);
+			}
+		}
+
+		vector<EllipseData> ellipses;
+		vector<double> squares;
+		vector<double> circles;
+		vector<const Graphic *> others;
+		vector<Run> runs;
+};
+
+const char * const GraphicScene::names[GraphicScene::PrimitiveKinds] = { "Ellipse \n", "Square \n", "Circle \n" };
+
+// The output of function on cout.
+template <class Function>
+string Captured(Function function)
+{
+	ostringstream captured;
+	streambuf * original = cout.rdbuf(captured.rdbuf());
+
+	function();
+
+	cout.rdbuf(original);
+
+	return captured.str();
+}
+
 int main()
 {
 	// Initialize four ellipses
-	const auto_ptr<Ellipse> ellipse1(new Ellipse());
-	const auto_ptr<Ellipse> ellipse2(new Ellipse());
-	const auto_ptr<Ellipse> ellipse3(new Ellipse());
+	const unique_ptr<Ellipse> ellipse1(new Ellipse());
+	const unique_ptr<Ellipse> ellipse2(new Ellipse());
+	const unique_ptr<Ellipse> ellipse3(new Ellipse());
 
 	// Initialize four squares
-	const auto_ptr<Square> square1(new Square());
-	const auto_ptr<Square> square2(new Square());
-	const auto_ptr<Square> square3(new Square());
+	const unique_ptr<Square> square1(new Square());
+	const unique_ptr<Square> square2(new Square());
+	const unique_ptr<Square> square3(new Square());
 
 	// Initialize four circles
-	const auto_ptr<Circle> circle1(new Circle());
-	const auto_ptr<Circle> circle2(new Circle());
-	const auto_ptr<Circle> circle3(new Circle());
+	const unique_ptr<Circle> circle1(new Circle());
+	const unique_ptr<Circle> circle2(new Circle());
+	const unique_ptr<Circle> circle3(new Circle());
 
 	// Initialize three composite graphics
-	const auto_ptr<CompositeGraphic> graphic1(new CompositeGraphic());
-	const auto_ptr<CompositeGraphic> graphic2(new CompositeGraphic());
-	const auto_ptr<CompositeGraphic> graphic3(new CompositeGraphic());
- 
+	const unique_ptr<CompositeGraphic> graphic1(new CompositeGraphic());
+	const unique_ptr<CompositeGraphic> graphic2(new CompositeGraphic());
+	const unique_ptr<CompositeGraphic> graphic3(new CompositeGraphic());
+
 	// Compose the graphics
 	graphic1->add(ellipse1.get());
 	graphic1->add(ellipse2.get());
@@ -90,14 +359,13 @@ int main()
 	graphic2->add(square1.get());
 	graphic2->add(square2.get());
 	graphic2->add(square3.get());
- 
+
 	graphic3->add(circle1.get());
 	graphic3->add(circle2.get());
 	graphic3->add(circle3.get());
 
 	graphic1->add(graphic3.get());
 	graphic2->add(graphic1.get());
- 
 
 	// Print the complete graphics
 	graphic1->print();
@@ -106,7 +374,103 @@ int main()
 	cout << endl;
 	graphic3->print();
 
+	// The same, bucketed by kind.
+	GraphicScene scene(*graphic2);
+
+	cout << endl << "scene: " << scene.primitives() << " primitives in " << scene.runCount() << " runs, same output: "
+		 << (Captured([&]() { scene.print(); }) == Captured([&]() { graphic2->print(); }) ? "yes" : "no") << endl;
+
+	// A scene of 3,000,000 primitives of random sizes in groups of 1000, each group drawn as strokes
+	// of 1 to 64 shapes of one random kind.
+	vector<unique_ptr<Graphic> > owned;
+	CompositeGraphic big;
+	unsigned seed = 3;
+
+	for (int g = 0; g < 3000; g++)
+	{
+		CompositeGraphic * group = new CompositeGraphic();
+
+		owned.push_back(unique_ptr<Graphic>(group));
+		big.add(group);
+
+		unsigned kind = 0, stroke = 0;
+
+		for (int i = 0; i < 1000; i++)
+		{
+			seed = seed * 1103515245u + 12345u;
+
+			unsigned r = seed >> 8;
+
+			if (stroke == 0)
+			{
+				kind = r / 100 % 3;
+				stroke = 1 + r / 300 % 64;
+			}
+
+			stroke--;
+
+			double size = 1.0 + r % 100 / 10.0;
+			Graphic * primitive;
+
+			switch (kind)
+			{
+				case 0: primitive = new Ellipse(size, size / 2); break;
+				case 1: primitive = new Square(size); break;
+				default: primitive = new Circle(size); break;
+			}
+
+			owned.push_back(unique_ptr<Graphic>(primitive));
+			group->add(primitive);
+		}
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	GraphicScene bigScene(big);
+	chrono::duration<double, milli> buildTime = chrono::steady_clock::now() - start;
+
+	start = chrono::steady_clock::now();
+	double compositeArea = big.area();
+	chrono::duration<double, milli> compositeTime = chrono::steady_clock::now() - start;
+
+	start = chrono::steady_clock::now();
+	double sceneArea = bigScene.area();
+	chrono::duration<double, milli> sceneTime = chrono::steady_clock::now() - start;
+
+	cout << bigScene.primitives() << " primitives in " << bigScene.runCount() << " runs" << endl;
+	cout << "composite area " << setprecision(17) << compositeArea << " in " << setprecision(3) << compositeTime.count() << " ms" << endl;
+	cout << "scene area     " << setprecision(17) << sceneArea << " in " << setprecision(3) << sceneTime.count()
+		 << " ms (bucketed in " << buildTime.count() << " ms)" << endl;
+
 	cin.get();
 
 	return 0;
-}
\ No newline at end of file
+}
+
+// Output (the timings will vary):
+/*
+Ellipse 
+Ellipse 
+Ellipse 
+Circle 
+Circle 
+Circle 
+
+Square 
+Square 
+Square 
+Ellipse 
+Ellipse 
+Ellipse 
+Circle 
+Circle 
+Circle 
+
+Circle 
+Circle 
+Circle 
+
+scene: 9 primitives in 7 runs, same output: yes
+3000000 primitives in 69952 runs
+composite area 249728857.2802009 in 18.4 ms
+scene area     249728857.2802009 in 6.14 ms (bucketed in 73.1 ms)
+*/
@@ -0,0 +1,138 @@
+// Composite Design Pattern - Structural Category
+
+// Freezing a composite into a flat array.
+
+// Composite::traverse() in Composite.h visits every node through a virtual call and a pointer to a
+// separately allocated object. FrozenComposite compiles the tree once into a contiguous preorder
+// array of (kind, value, subtree size) entries, on which traverse(), sum() and visit() are linear scans.
+
+// The benchmark builds a tree of 4,000,000 leaves under 10,000 composites. The leaves are allocated
+// first and attached in random order, as they would be in a tree that has grown over time, so that
+// neighbours in the tree are not neighbours in memory. It then compares the walks of the original
+// and of the frozen tree.
+
+// http://en.wikipedia.org/wiki/Locality_of_reference
+
+#include <chrono>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <algorithm>
+
+#include "Composite.h"
+
+using namespace std;
+
+// Counts the leaves whose value is a multiple of 7.
+struct CountMultiples
+{
+	size_t count;
+
+	void operator()(int value)
+	{
+		if (value % 7 == 0)
+		{
+			count++;
+		}
+	}
+};
+
+template <class Function>
+double Milliseconds(Function function)
+{
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	function();
+
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+	return elapsed.count();
+}
+
+
+int main()
+{
+	const int branches = 100, groups = 100, leavesPerGroup = 400;
+	const int leafCount = branches * groups * leavesPerGroup;
+
+	vector<Leaf *> leaves;
+
+	for (int i = 0; i < leafCount; i++)
+	{
+		leaves.push_back(new Leaf(i % 1000));
+	}
+
+	unsigned seed = 42;
+
+	for (int i = leafCount - 1; i > 0; i--)
+	{
+		seed = seed * 1103515245u + 12345u;
+		swap(leaves[i], leaves[(seed >> 8) % (i + 1)]);
+	}
+
+	Composite root;
+	vector<Composite> composites(branches + branches * groups);
+
+	for (int b = 0; b < branches; b++)
+	{
+		Composite & branch = composites[b];
+
+		root.add(&branch);
+
+		for (int g = 0; g < groups; g++)
+		{
+			Composite & group = composites[branches + b * groups + g];
+
+			branch.add(&group);
+
+			for (int l = 0; l < leavesPerGroup; l++)
+			{
+				group.add(leaves[(b * groups + g) * leavesPerGroup + l]);
+			}
+		}
+	}
+
+	FrozenComposite * frozen = NULL;
+
+	double freezeTime = Milliseconds([&]() { frozen = new FrozenComposite(root); });
+
+	cout << frozen->leaves() << " leaves, " << frozen->size() << " entries, frozen in " << freezeTime << " ms" << endl << endl;
+
+	long long pointerSum = 0, frozenSum = 0;
+	double pointerSumTime = Milliseconds([&]() { pointerSum = root.sum(); });
+	double frozenSumTime = Milliseconds([&]() { frozenSum = frozen->sum(); });
+
+	cout << "sum:       pointers " << pointerSumTime << " ms, frozen " << frozenSumTime << " ms"
+		 << (pointerSum == frozenSum ? "" : "   (sums differ!)") << endl;
+
+	CountMultiples frozenCount = { 0 };
+	double frozenVisitTime = Milliseconds([&]() { frozen->visit(frozenCount); });
+
+	ostringstream pointerText, frozenText;
+	double pointerTraverseTime = Milliseconds([&]() { root.traverse(pointerText); });
+	double frozenTraverseTime = Milliseconds([&]() { frozen->traverse(frozenText); });
+
+	cout << "traverse:  pointers " << pointerTraverseTime << " ms, frozen " << frozenTraverseTime << " ms"
+		 << (pointerText.str() == frozenText.str() ? "" : "   (outputs differ!)") << endl;
+	cout << "visit:     frozen " << frozenVisitTime << " ms, " << frozenCount.count << " multiples of 7" << endl;
+
+	delete frozen;
+
+	for (size_t i = 0; i < leaves.size(); i++)
+	{
+		delete leaves[i];
+	}
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the timings will vary):
+/*
+4000000 leaves, 4010101 entries, frozen in 220.187 ms
+
+sum:       pointers 53.1608 ms, frozen 5.88422 ms
+traverse:  pointers 246.345 ms, frozen 117.66 ms
+visit:     frozen 7.3824 ms, 572000 multiples of 7
+*/
@@ -0,0 +1,183 @@
+// Composite Design Pattern - Structural Category
+
+// Composite trees allocated from an arena.
+
+// Every PrimitiveElement and CompositeElement of CompositeElement.h created by new is allocated on its
+// own, and owns a name that is allocated once more if it is longer than the string's inline buffer.
+// Building a tree of millions of nodes is then millions of calls to the allocator, and deleting it
+// visits every node again to free it one by one.
+
+// The same classes can take their memory from a std::pmr::memory_resource instead. Element::Create()
+// allocates an element and its name from a pmr::monotonic_buffer_resource, the arena:
+// - an allocation is a pointer bump in a large block, and consecutive nodes sit next to each other;
+// - the tree holds nothing outside the arena, so it is never deleted node by node: the whole tree is
+//   released at once, in a handful of calls that give the blocks back, when the arena is released.
+// The tree is the same Composite as any other - elements can be added, removed and displayed as usual;
+// the memory of removed elements comes back with the arena's.
+
+// The benchmark builds the same tree of 4,000,000 elements both ways and compares the time to build
+// it, the memory it takes and the time to release it.
+
+// http://en.wikipedia.org/wiki/Region-based_memory_management
+// http://en.cppreference.com/w/cpp/memory/monotonic_buffer_resource
+
+#include <chrono>
+#include <string>
+#include <cstdio>
+#include <iostream>
+#include <memory_resource>
+
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+#include "CompositeElement.h"
+
+using namespace std;
+
+// Resident memory of the process, in MB; 0 where it is not known.
+double ResidentMemory()
+{
+#if defined(__linux__)
+	long pages = 0, resident = 0;
+	FILE * statm = fopen("/proc/self/statm", "r");
+
+	if (statm != NULL)
+	{
+		if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+		{
+			resident = 0;
+		}
+
+		fclose(statm);
+	}
+
+	return resident * (sysconf(_SC_PAGESIZE) / 1024.0) / 1024.0;
+#else
+	return 0;
+#endif
+}
+
+double Since(chrono::steady_clock::time_point start)
+{
+	chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+	return elapsed.count();
+}
+
+
+int main()
+{
+	// The sample tree of Composite2.cpp, allocated from an arena.
+	{
+		pmr::monotonic_buffer_resource arena;
+
+		Element * root = Element::Create<CompositeElement>(&arena, "Paintings");
+		root->Add(Element::Create<PrimitiveElement>(&arena, "Storm"));
+		root->Add(Element::Create<PrimitiveElement>(&arena, "Seashore"));
+
+		Element * comp1 = Element::Create<CompositeElement>(&arena, "Geometric figures");
+		comp1->Add(Element::Create<PrimitiveElement>(&arena, "Black Circle"));
+		comp1->Add(Element::Create<PrimitiveElement>(&arena, "White Triangle"));
+		root->Add(comp1);
+
+		Element * comp2 = Element::Create<CompositeElement>(&arena, "Animals");
+		Element * cat = Element::Create<PrimitiveElement>(&arena, "Cat");
+		comp2->Add(Element::Create<PrimitiveElement>(&arena, "Horse"));
+		comp2->Add(cat);
+		comp2->Add(Element::Create<PrimitiveElement>(&arena, "Dog"));
+		root->Add(comp2);
+
+		comp2->Remove(cat);
+
+		root->Display(1);
+
+		// The tree goes with the arena.
+	}
+
+	// 4000 folders of 1000 files.
+	const int folders = 4000, files = 1000;
+	char name[64];
+
+	// The arena first, so that it does not reuse memory the heap tree has given back to malloc.
+	double arenaBuild, arenaMemory, arenaRelease;
+
+	{
+		pmr::monotonic_buffer_resource arena(1 << 20);
+
+		double before = ResidentMemory();
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		Element * arenaRoot = Element::Create<CompositeElement>(&arena, "Disk");
+
+		for (int f = 0; f < folders; f++)
+		{
+			snprintf(name, sizeof(name), "Folder number %d of the disk", f);
+			Element * folder = Element::Create<CompositeElement>(&arena, name);
+			arenaRoot->Add(folder);
+
+			for (int i = 0; i < files; i++)
+			{
+				snprintf(name, sizeof(name), "Document %d in folder %d", i, f);
+				folder->Add(Element::Create<PrimitiveElement>(&arena, name));
+			}
+		}
+
+		arenaBuild = Since(start);
+		arenaMemory = ResidentMemory() - before;
+
+		start = chrono::steady_clock::now();
+		arena.release();
+		arenaRelease = Since(start);
+	}
+
+	double before = ResidentMemory();
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	CompositeElement * heapRoot = new CompositeElement("Disk");
+
+	for (int f = 0; f < folders; f++)
+	{
+		snprintf(name, sizeof(name), "Folder number %d of the disk", f);
+		CompositeElement * folder = new CompositeElement(name);
+		heapRoot->Add(folder);
+
+		for (int i = 0; i < files; i++)
+		{
+			snprintf(name, sizeof(name), "Document %d in folder %d", i, f);
+			folder->Add(new PrimitiveElement(name));
+		}
+	}
+
+	double heapBuild = Since(start);
+	double heapMemory = ResidentMemory() - before;
+
+	start = chrono::steady_clock::now();
+	delete heapRoot;
+	double heapRelease = Since(start);
+
+	cout << endl << folders * (files + 1) + 1 << " elements" << endl;
+	cout << "new / delete: built in " << heapBuild << " ms, " << heapMemory << " MB, released in " << heapRelease << " ms" << endl;
+	cout << "arena:        built in " << arenaBuild << " ms, " << arenaMemory << " MB, released in " << arenaRelease << " ms" << endl;
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the timings and memory will vary):
+/*
+-+ Paintings
+--- Storm
+--- Seashore
+---+ Geometric figures
+----- Black Circle
+----- White Triangle
+---+ Animals
+----- Horse
+----- Dog
+
+4004001 elements
+new / delete: built in 1502.76 ms, 609.992 MB, released in 159.883 ms
+arena:        built in 1078.6 ms, 489.098 MB, released in 28.8568 ms
+*/
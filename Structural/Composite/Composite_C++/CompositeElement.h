@@ -0,0 +1,389 @@
+
+//************************************************************************/
+//* CompositeElement.h                                                   */
+//************************************************************************/
+
+// The Element, PrimitiveElement and CompositeElement classes of Composite2.cpp, shared by the Composite samples.
+
+// A CompositeElement keeps its children in an intrusive doubly linked list: every Element carries
+// the links to its siblings and to its parent. The Element pointer itself is the handle to the child,
+// so Remove() unlinks it in O(1) without searching, and the destructor deletes the children in one
+// pass. Folder-like trees with 100,000s of children per node and frequent changes stay linear.
+
+// Elements and their names are allocated from a std::pmr::memory_resource, new and delete by default.
+// Element::Create<E>(resource, name) makes an element whose node and name both come from resource,
+// e.g. a monotonic_buffer_resource: building a tree is then a pointer bump per allocation, and since
+// such a tree holds nothing outside its resource, it may be dropped by releasing the resource at once
+// instead of deleting it node by node. Remove() and delete work the same in every mode.
+
+// Display() writes the tree through a DisplayWriter: one line per element, appended to a reusable
+// 1 MB buffer that is written out in one piece when it is full, instead of a new indentation string
+// and a flushed cout line per element. The indentation is cut from one string of dashes that only
+// grows when the tree gets deeper. Display(indent) writes to cout; Display(writer, indent) to any
+// ostream, e.g. a file being serialized, or on POSIX systems straight to a file descriptor.
+
+// http://advancedcppwithexamples.blogspot.co.il/2010/09/c-example-for-composite-design-pattern.html
+
+#ifndef MY_COMPOSITEELEMENT_HEADER
+#define MY_COMPOSITEELEMENT_HEADER
+
+#include<new>
+#include<string>
+#include<cstring>
+#include<cstddef>
+#include<iostream>
+#include<string_view>
+#include<memory_resource>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include<cerrno>
+#include<unistd.h>
+#endif
+
+// Writes lines of a tree dump through a fixed buffer to a stream or a file descriptor.
+class DisplayWriter
+{
+	public:
+
+		static const std::size_t Capacity = 1 << 20;
+
+		DisplayWriter(std::ostream & stream)
+			: stream(&stream), fd(-1), buffer(new char[Capacity]), used(0), lines(0), failed(false), dashes(64, '-')
+		{
+		}
+
+#if defined(__unix__) || defined(__APPLE__)
+		DisplayWriter(int fd)
+			: stream(NULL), fd(fd), buffer(new char[Capacity]), used(0), lines(0), failed(false), dashes(64, '-')
+		{
+		}
+#endif
+
+		// Call Flush() before to see write errors; the destructor cannot report them.
+		~DisplayWriter()
+		{
+			Flush();
+			delete [] buffer;
+		}
+
+		// Writes "<indent dashes><marker><name>\n".
+		void Line(int indent, const char * marker, std::string_view name)
+		{
+			std::size_t markerLength = std::strlen(marker);
+			std::size_t length = indent + markerLength + name.length() + 1;
+
+			if (static_cast<std::size_t>(indent) > dashes.length())
+			{
+				dashes.resize(2 * indent, '-');
+			}
+
+			if (used + length > Capacity)
+			{
+				Flush();
+			}
+
+			if (length > Capacity)
+			{
+				// A name longer than the buffer: written piece by piece.
+				WriteAll(dashes.data(), indent);
+				WriteAll(marker, markerLength);
+				WriteAll(name.data(), name.length());
+				WriteAll("\n", 1);
+			}
+			else
+			{
+				char * p = buffer + used;
+
+				std::memcpy(p, dashes.data(), indent);
+				std::memcpy(p + indent, marker, markerLength);
+				std::memcpy(p + indent + markerLength, name.data(), name.length());
+				p[length - 1] = '\n';
+
+				used += length;
+			}
+
+			lines++;
+		}
+
+		// Returns false if writing has failed, now or earlier; the output is then incomplete.
+		bool Flush()
+		{
+			WriteAll(buffer, used);
+			used = 0;
+
+			return !failed;
+		}
+
+		// Number of lines, that is elements, written so far.
+		std::size_t Lines() const
+		{
+			return lines;
+		}
+
+	private:
+
+		DisplayWriter(const DisplayWriter &); // not allowed
+		DisplayWriter & operator=(const DisplayWriter &); // not allowed
+
+		// After the first failure, e.g. a closed pipe or a full disk, the rest of the output is dropped.
+		void WriteAll(const char * text, std::size_t length)
+		{
+			if (failed || length == 0)
+			{
+				return;
+			}
+
+			if (stream != NULL)
+			{
+				failed = !stream->write(text, static_cast<std::streamsize>(length));
+
+				return;
+			}
+
+#if defined(__unix__) || defined(__APPLE__)
+			while (length > 0)
+			{
+				ssize_t n = write(fd, text, length);
+
+				if (n < 0 && errno == EINTR)
+				{
+					continue;
+				}
+
+				if (n <= 0)
+				{
+					failed = true;
+
+					return;
+				}
+
+				text += n;
+				length -= static_cast<std::size_t>(n);
+			}
+#endif
+		}
+
+		std::ostream * const stream;
+		const int fd;
+		char * const buffer;
+		std::size_t used;
+		std::size_t lines;
+		bool failed;
+		std::string dashes;
+};
+
+//The 'Component' Treenode
+class Element
+{
+	public:
+
+		Element(std::string_view name, std::pmr::memory_resource * resource = std::pmr::new_delete_resource())
+			: name(name, resource), parent(NULL), previous(NULL), next(NULL) { };
+		virtual void Add(Element * d) = 0;
+		virtual void Remove(Element * d) = 0;
+		virtual void Display(DisplayWriter & out, int indent) = 0;
+		virtual ~Element() {};
+
+		// Displays the element and its children on cout.
+		void Display(int indent)
+		{
+			DisplayWriter out(std::cout);
+
+			Display(out, indent);
+		}
+
+		// Creates an element of class E whose node and name are allocated from resource.
+		template <class E>
+		static E * Create(std::pmr::memory_resource * resource, std::string_view name)
+		{
+			return new (resource) E(name, resource);
+		}
+
+		// Every element records the resource it was allocated from in front of the object,
+		// so that delete gives it back there, whichever way it was created.
+		static void * operator new(std::size_t size)
+		{
+			return operator new(size, std::pmr::new_delete_resource());
+		}
+
+		static void * operator new(std::size_t size, std::pmr::memory_resource * resource)
+		{
+			char * block = static_cast<char *>(resource->allocate(Header + size, alignof(std::max_align_t)));
+			Allocation allocation = { resource, Header + size };
+
+			std::memcpy(block, &allocation, sizeof(allocation));
+
+			return block + Header;
+		}
+
+		static void operator delete(void * p)
+		{
+			char * block = static_cast<char *>(p) - Header;
+			Allocation allocation;
+
+			std::memcpy(&allocation, block, sizeof(allocation));
+			allocation.resource->deallocate(block, allocation.size, alignof(std::max_align_t));
+		}
+
+		// Called if a constructor throws.
+		static void operator delete(void * p, std::pmr::memory_resource *)
+		{
+			operator delete(p);
+		}
+
+	protected:
+
+		std::pmr::string name;
+		
+	private:
+
+		friend class CompositeElement;
+
+		struct Allocation
+		{
+			std::pmr::memory_resource * resource;
+			std::size_t size;
+		};
+
+		// The Allocation in front of an element, rounded up to keep the element aligned.
+		static const std::size_t Header = (sizeof(Allocation) + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+
+		Element(); // disallowed
+
+		// Links in the child list of the parent.
+		Element * parent;
+		Element * previous;
+		Element * next;
+};
+
+// The 'Leaf' class
+class PrimitiveElement : public Element
+{
+	public:
+
+		PrimitiveElement(std::string_view name, std::pmr::memory_resource * resource = std::pmr::new_delete_resource())
+			: Element(name, resource) { };
+
+		void Add(Element *)
+		{
+			std::cout << "Cannot add to a PrimitiveElement" << std::endl;
+		}
+	
+		void Remove(Element *)
+		{
+			std::cout << "Cannot remove from a PrimitiveElement" << std::endl;
+		}
+	
+		using Element::Display;
+
+		void Display(DisplayWriter & out, int indent)
+		{
+			out.Line(indent, " ", name);
+		}
+	
+		virtual ~PrimitiveElement() { };
+	
+	private:
+
+		PrimitiveElement(); // not allowed
+};
+
+// The 'Composite' class
+class CompositeElement : public Element
+{
+	public:
+
+		CompositeElement(std::string_view name, std::pmr::memory_resource * resource = std::pmr::new_delete_resource())
+			: Element(name, resource), first(NULL), last(NULL), count(0) { };
+
+		// d must not be a child of another CompositeElement; this one takes ownership of it.
+		void Add(Element * d)
+		{
+			d->parent = this;
+			d->previous = last;
+			d->next = NULL;
+
+			if (last != NULL)
+			{
+				last->next = d;
+			}
+			else
+			{
+				first = d;
+			}
+
+			last = d;
+			count++;
+		}
+	
+		// Removes and deletes d if it is a child of this element.
+		void Remove(Element * d)
+		{
+			if (d->parent != this)
+			{
+				return;
+			}
+
+			if (d->previous != NULL)
+			{
+				d->previous->next = d->next;
+			}
+			else
+			{
+				first = d->next;
+			}
+
+			if (d->next != NULL)
+			{
+				d->next->previous = d->previous;
+			}
+			else
+			{
+				last = d->previous;
+			}
+
+			count--;
+
+			delete d;
+		}
+
+		using Element::Display;
+
+		void Display(DisplayWriter & out, int indent)
+		{
+			out.Line(indent, "+ ", name);
+
+			for (Element * child = first; child != NULL; child = child->next)
+			{
+				child->Display(out, indent + 2);
+			}
+		}
+
+		std::size_t Count() const
+		{
+			return count;
+		}
+	
+		virtual ~CompositeElement()
+		{
+			Element * child = first;
+
+			while (child != NULL)
+			{
+				Element * next = child->next;
+				delete child;
+				child = next;
+			}
+		}
+	
+	private:
+	
+		CompositeElement(); // not allowed
+
+		Element * first;
+		Element * last;
+		std::size_t count;
+
+};
+
+#endif
@@ -0,0 +1,339 @@
+
+//************************************************************************/
+//* Character.h                                                          */
+//************************************************************************/
+
+// The Character flyweights and the CharacterFactory of Flyweight1.cpp, shared by the Flyweight samples.
+
+// http://advancedcppwithexamples.blogspot.co.il/2010/10/c-example-of-flyweight-design-pattern.html
+
+#ifndef MY_CHARACTER_HEADER
+#define MY_CHARACTER_HEADER
+
+#include <string>
+#include <cstring>
+#include <charconv>
+#include <ostream>
+#include <sstream>
+#include <iostream>
+#include <exception>
+
+// The 'Flyweight' abstract class
+// A flyweight is shared by every occurrence of its character, possibly on several threads at once,
+// so it is immutable: the intrinsic state is set by the constructor and the extrinsic state
+// (the point size and where to draw) is passed to every call instead of being stored.
+// Display() ends the line with '\n' rather than endl: flushing the stream once per character
+// would dominate the cost of rendering a document. AppendTo() appends the same text to a string,
+// for renderers that collect their output in a buffer; by default it formats through Display(),
+// and the characters below override it with a version that does not go through a stream.
+class Character
+{
+	public:
+		
+		virtual ~Character() { }
+		virtual void Display(int point_size, std::ostream & out = std::cout) const = 0;
+
+		virtual void AppendTo(std::string & buffer, int point_size) const
+		{
+			std::ostringstream out;
+
+			Display(point_size, out);
+			buffer += out.str();
+		}
+
+		char GetSymbol() const { return symbol; }
+		int GetWidth() const { return width; }
+		int GetHeight() const { return height; }
+		int GetAscent() const { return ascent; }
+		int GetDescent() const { return descent; }
+
+	protected:
+
+		Character(char symbol, int width, int height, int ascent, int descent)
+			: symbol(symbol), width(width), height(height), ascent(ascent), descent(descent)
+		{
+		}
+
+		// Appends "<text> (Point size <point_size> )\n", the line of Display(), with a single append.
+		static void AppendLine(std::string & buffer, const char * text, std::size_t length, int point_size)
+		{
+			char line[64];
+
+			if (length > sizeof(line) - 32)
+			{
+				buffer.append(text, length);
+				length = 0;
+			}
+
+			std::memcpy(line, text, length);
+			std::memcpy(line + length, " (Point size ", 13);
+
+			char * end = std::to_chars(line + length + 13, line + sizeof(line) - 3, point_size).ptr;
+
+			std::memcpy(end, " )\n", 3);
+			buffer.append(line, end + 3 - line);
+		}
+
+		const char symbol;
+		const int width;
+		const int height;
+		const int ascent;
+		const int descent;
+};
+
+// A 'ConcreteFlyweight' class
+class CharacterA : public Character
+{
+	public:
+
+		CharacterA() : Character('A', 120, 100, 70, 0) { }
+
+		void Display(int point_size, std::ostream & out = std::cout) const
+		{
+			out << symbol << " (Point size " << point_size << " )\n";
+		}
+
+		void AppendTo(std::string & buffer, int point_size) const
+		{
+			AppendLine(buffer, &symbol, 1, point_size);
+		}
+};
+
+// A 'ConcreteFlyweight' class
+class CharacterB : public Character
+{
+	public:
+
+		CharacterB() : Character('B', 140, 100, 72, 0) { }
+
+		void Display(int point_size, std::ostream & out = std::cout) const
+		{
+			out << symbol << " (Point size " << point_size << " )\n";
+		}
+
+		void AppendTo(std::string & buffer, int point_size) const
+		{
+			AppendLine(buffer, &symbol, 1, point_size);
+		}
+};
+
+// C, D, E, ...
+
+// A 'ConcreteFlyweight' class
+class CharacterZ : public Character
+{
+	public:
+
+		CharacterZ() : Character('Z', 100, 100, 68, 0) { }
+
+		void Display(int point_size, std::ostream & out = std::cout) const
+		{
+			out << symbol << " (Point size " << point_size << " )\n";
+		}
+
+		void AppendTo(std::string & buffer, int point_size) const
+		{
+			AppendLine(buffer, &symbol, 1, point_size);
+		}
+};
+
+// A 'ConcreteFlyweight' class shown in place of the characters that have no glyph
+class CharacterReplacement : public Character
+{
+	public:
+
+		CharacterReplacement() : Character('?', 110, 100, 70, 0) { }
+
+		void Display(int point_size, std::ostream & out = std::cout) const
+		{
+			out << symbol << " (Point size " << point_size << " )\n";
+		}
+
+		void AppendTo(std::string & buffer, int point_size) const
+		{
+			AppendLine(buffer, &symbol, 1, point_size);
+		}
+};
+
+// A 'ConcreteFlyweight' class for a code point outside the hand-written ASCII glyphs
+class UnicodeCharacter : public Character
+{
+	public:
+
+		UnicodeCharacter(char32_t codepoint, int width, int height, int ascent, int descent)
+			: Character('?', width, height, ascent, descent), codepoint(codepoint)
+		{
+		}
+
+		void Display(int point_size, std::ostream & out = std::cout) const
+		{
+			out << Encode(codepoint) << " (Point size " << point_size << " )\n";
+		}
+
+		void AppendTo(std::string & buffer, int point_size) const
+		{
+			std::string utf8 = Encode(codepoint);
+
+			AppendLine(buffer, utf8.data(), utf8.length(), point_size);
+		}
+
+		// UTF-8 encoding of a valid code point.
+		static std::string Encode(char32_t cp)
+		{
+			std::string utf8;
+
+			if (cp < 0x80)
+			{
+				utf8 += static_cast<char>(cp);
+			}
+			else if (cp < 0x800)
+			{
+				utf8 += static_cast<char>(0xC0 | (cp >> 6));
+				utf8 += static_cast<char>(0x80 | (cp & 0x3F));
+			}
+			else if (cp < 0x10000)
+			{
+				utf8 += static_cast<char>(0xE0 | (cp >> 12));
+				utf8 += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+				utf8 += static_cast<char>(0x80 | (cp & 0x3F));
+			}
+			else
+			{
+				utf8 += static_cast<char>(0xF0 | (cp >> 18));
+				utf8 += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+				utf8 += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+				utf8 += static_cast<char>(0x80 | (cp & 0x3F));
+			}
+
+			return utf8;
+		}
+
+	private:
+
+		const char32_t codepoint;
+};
+
+
+class MyException : public std::exception
+{
+	private:
+
+		std::string s;
+
+	public:
+
+		MyException(std::string ss) : s(ss) { }
+		~MyException() throw () { } // Updated
+		const char * what() const throw() { return s.c_str(); }
+};
+
+// The 'FlyweightFactory' class
+class CharacterFactory
+{
+	public:
+
+		// With preload set, the flyweights of all the supported characters are created up front,
+		// otherwise each one is created the first time it is asked for. Only a preloaded factory
+		// may be used by several threads at the same time.
+		CharacterFactory(bool preload = false) : preloaded(preload)
+		{
+			for (int i = 0; i < TableSize; i++)
+			{
+				characters[i] = NULL;
+			}
+
+			if (preload)
+			{
+				for (int i = 0; i < TableSize; i++)
+				{
+					characters[i] = CreateCharacter(static_cast<char>(i));
+				}
+			}
+		}
+
+		virtual ~CharacterFactory()
+		{
+			for (int i = 0; i < TableSize; i++)
+			{
+				delete characters[i];
+			}
+		}
+
+		const Character * GetCharacter(char key)
+		{
+			const Character * character = FindCharacter(key);
+
+			if (character == NULL)
+			{
+				std::string msg = "Character ";
+				msg += static_cast<char>(key);
+				msg += " is NOT implemented.";
+				
+				// throw msg;
+				throw MyException(msg);
+			}
+
+			return character;
+		}
+
+		// Returns NULL if the character is not supported.
+		const Character * FindCharacter(char key)
+		{
+			Character * character = characters[static_cast<unsigned char>(key)];
+
+			if (character == NULL && !preloaded)
+			{
+				character = CreateCharacter(key);
+				characters[static_cast<unsigned char>(key)] = character;
+			}
+
+			return character;
+		}
+
+		// Returns the replacement glyph if the character is not supported.
+		const Character * GetCharacterOrReplacement(char key)
+		{
+			const Character * character = FindCharacter(key);
+
+			return (character != NULL) ? character : &replacement;
+		}
+
+		const Character * GetReplacement() const
+		{
+			return &replacement;
+		}
+
+	private:
+
+		static const int TableSize = 256;
+
+		// Returns NULL for the characters that are not supported.
+		static Character * CreateCharacter(char key)
+		{
+			switch(key)
+			{
+				case 'A':
+					return new CharacterA();
+
+				case 'B':
+					return new CharacterB();
+
+				// ...
+
+				case 'Z':
+					return new CharacterZ();
+
+				default:
+					return NULL;
+			}
+		}
+
+		CharacterFactory(const CharacterFactory &); // not allowed
+		CharacterFactory & operator=(const CharacterFactory &); // not allowed
+
+		const bool preloaded;
+		Character * characters[TableSize];
+		CharacterReplacement replacement;
+};
+
+#endif
@@ -0,0 +1,198 @@
+//************************************************************************/
+//* Flyweight.h                                                          */
+//************************************************************************/
+
+// Generic hash-consing Flyweight factory.
+
+// Flyweight<T, Key, Hash> interns values: intern(key) returns the one shared T that is equal to key,
+// creating it from key the first time it is asked for. Equal values are therefore stored only once,
+// and two interned values are equal exactly when their addresses are, so they can be compared and
+// hashed by address afterwards.
+// - Key is the type values are looked up by. It defaults to T, but it may be a lighter view of T as
+//   long as a const T converts to a Key and a T can be constructed from a Key: with
+//   Flyweight<std::string, std::string_view> looking up a string that is already interned never
+//   allocates a std::string.
+// - Hash hashes a Key. Two values that are equal as Keys must be the same value.
+// - The values are constructed in fixed-size blocks that are never moved or freed before the
+//   Flyweight itself, so the references returned by intern() stay valid for its whole lifetime.
+// - The index is an open-addressing table with linear probing. Each slot holds the value's full
+//   hash next to its address, so a probe only touches a value whose hash matches, and growing the
+//   table never rehashes a value.
+
+// The Flyweight is not thread-safe.
+
+// http://en.wikipedia.org/wiki/Hash_consing
+// http://en.wikipedia.org/wiki/Open_addressing
+
+#ifndef MY_FLYWEIGHT_HEADER
+#define MY_FLYWEIGHT_HEADER
+
+#include <new>
+#include <vector>
+#include <cstddef>
+#include <functional>
+
+template <class T, class Key = T, class Hash = std::hash<Key>, std::size_t BlockSize = 1024>
+class Flyweight : private Hash
+{
+	public:
+
+		explicit Flyweight(const Hash & hash = Hash())
+			: Hash(hash), slots(MinCapacity), count(0), carved(BlockSize)
+		{
+		}
+
+		~Flyweight()
+		{
+			for (std::size_t i = 0; i < blocks.size(); i++)
+			{
+				std::size_t used = (i + 1 == blocks.size()) ? carved : BlockSize;
+
+				for (std::size_t j = 0; j < used; j++)
+				{
+					blocks[i][j].~T();
+				}
+
+				::operator delete(blocks[i]);
+			}
+		}
+
+		// Returns the shared value equal to key, creating it if there is none yet.
+		const T & intern(const Key & key)
+		{
+			std::size_t hash = hashOf(key);
+			std::size_t i = probe(key, hash);
+
+			if (slots[i].value != NULL)
+			{
+				return *slots[i].value;
+			}
+
+			const T * value = create(key);
+
+			slots[i].hash = hash;
+			slots[i].value = value;
+			count++;
+
+			// Keep the table at most 3/4 full, so that probe sequences stay short.
+			if (count * 4 > slots.size() * 3)
+			{
+				grow();
+			}
+
+			return *value;
+		}
+
+		// Returns the shared value equal to key, NULL if it has not been interned.
+		const T * find(const Key & key) const
+		{
+			return slots[probe(key, hashOf(key))].value;
+		}
+
+		// Number of distinct values.
+		std::size_t size() const
+		{
+			return count;
+		}
+
+		// Memory taken by the blocks of values and by the index, not counting
+		// what the values themselves allocate.
+		std::size_t bytes() const
+		{
+			return blocks.size() * BlockSize * sizeof(T) + slots.size() * sizeof(Slot)
+				 + blocks.capacity() * sizeof(T *);
+		}
+
+	private:
+
+		static const std::size_t MinCapacity = 16;
+
+		struct Slot
+		{
+			Slot() : hash(0), value(NULL) { }
+
+			std::size_t hash;
+			const T * value;	// NULL if the slot is empty.
+		};
+
+		Flyweight(const Flyweight &); // not allowed
+		Flyweight & operator=(const Flyweight &); // not allowed
+
+		std::size_t hashOf(const Key & key) const
+		{
+			return static_cast<const Hash &>(*this)(key);
+		}
+
+		// Index of the slot that holds the value equal to key, or of the empty slot where it belongs.
+		std::size_t probe(const Key & key, std::size_t hash) const
+		{
+			std::size_t mask = slots.size() - 1;
+
+			for (std::size_t i = hash & mask; ; i = (i + 1) & mask)
+			{
+				const Slot & slot = slots[i];
+
+				if (slot.value == NULL)
+				{
+					return i;
+				}
+
+				if (slot.hash == hash)
+				{
+					// Binds directly if Key is T, converts (e.g. std::string to std::string_view) otherwise.
+					const Key & other = *slot.value;
+
+					if (other == key)
+					{
+						return i;
+					}
+				}
+			}
+		}
+
+		const T * create(const Key & key)
+		{
+			if (carved == BlockSize)
+			{
+				blocks.push_back(static_cast<T *>(::operator new(BlockSize * sizeof(T))));
+				carved = 0;
+			}
+
+			T * value = new (blocks.back() + carved) T(key);
+
+			carved++;
+
+			return value;
+		}
+
+		void grow()
+		{
+			std::vector<Slot> old(slots.size() * 2);
+
+			old.swap(slots);
+
+			std::size_t mask = slots.size() - 1;
+
+			for (std::size_t i = 0; i < old.size(); i++)
+			{
+				if (old[i].value != NULL)
+				{
+					std::size_t j = old[i].hash & mask;
+
+					while (slots[j].value != NULL)
+					{
+						j = (j + 1) & mask;
+					}
+
+					slots[j] = old[i];
+				}
+			}
+		}
+
+		std::vector<Slot> slots;		// Power-of-two size.
+		std::size_t count;
+		std::vector<T *> blocks;
+		std::size_t carved;				// Values constructed in the last block.
+};
+
+#endif
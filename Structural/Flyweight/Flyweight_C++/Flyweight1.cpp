@@ -24,174 +24,132 @@
 // Below is an example of charachter class. 
 // Each character is unique and can have different size, but the rest of the features remain the same.
 
+// The factory keeps its flyweights in a table with one entry per possible char value, indexed directly
+// by the character code. Finding the glyph of a character is a single load from a 256-entry array instead
+// of a search through a std::map, which matters because it is done for every character of the document.
+// The table is filled lazily as characters are met, or all at once by the constructor if asked to.
+
+// GetCharacter() throws MyException for a character that has no glyph. Unwinding the stack for every
+// such character is very expensive on text with many unsupported characters, so the factory offers two
+// paths that never throw and never allocate: FindCharacter() returns NULL, and GetCharacterOrReplacement()
+// returns a shared replacement glyph, itself a flyweight, as text renderers usually do.
+
+// The Character flyweights are immutable, so once a factory has been filled at construction it is only
+// ever read and can be shared by several threads. RenderParallel() uses this to split a document into
+// chunks, render them on all the cores at once, and join the output of the chunks in document order.
+
 // http://advancedcppwithexamples.blogspot.co.il/2010/10/c-example-of-flyweight-design-pattern.html
 
-#include <map>
+#include <chrono>
 #include <string>
+#include <thread>
+#include <vector>
+#include <sstream>
 #include <iostream>
 
+#include "Character.h"
+
 using namespace std;
 
-// The 'Flyweight' abstract class
-class Character
+// Renders characters first to last - 1 of the document; character i gets point size first_point_size + i.
+void RenderChunk(CharacterFactory * factory, const string * document, size_t first, size_t last,
+				 int first_point_size, string * output)
 {
-	public:
-		
-		virtual void Display(int point_size) = 0;
-
-	protected:
-
-		char symbol;
-		int width;
-		int height;
-		int ascent;
-		int descent;
-		int point_size;
-};
-
-// A 'ConcreteFlyweight' class
-class CharacterA : public Character
-{
-	public:
-
-		CharacterA()
-		{
-			symbol    = 'A';
-			width     = 120;
-			height    = 100;
-			ascent    = 70;
-			descent   = 0;
-			point_size = 0; // Initialize
-		}
+	ostringstream out;
 
-	void Display(int point_size)
+	for (size_t i = first; i < last; i++)
 	{
-		this->point_size = point_size;
-		cout << symbol << " (Point size " << point_size << " )" << endl;
+		factory->GetCharacterOrReplacement((*document)[i])->Display(first_point_size + static_cast<int>(i), out);
 	}
-};
 
-// A 'ConcreteFlyweight' class
-class CharacterB : public Character
+	*output = out.str();
+}
+
+// Renders the document on the given number of threads, each one taking a contiguous chunk.
+// The factory must be preloaded. The result is the same as rendering the whole document on one thread.
+string RenderParallel(CharacterFactory & factory, const string & document, int first_point_size, unsigned threads)
 {
-	public:
+	vector<string> chunks(threads);
+	vector<thread> workers;
 
-	CharacterB()
+	for (unsigned t = 0; t < threads; t++)
 	{
-		symbol    = 'B';
-		width     = 140;
-		height    = 100;
-		ascent    = 72;
-		descent   = 0;
-		point_size = 0; // Initialize
+		size_t first = document.length() * t / threads;
+		size_t last = document.length() * (t + 1) / threads;
+
+		workers.push_back(thread(RenderChunk, &factory, &document, first, last, first_point_size, &chunks[t]));
 	}
 
-	void Display(int point_size)
+	string output;
+
+	for (unsigned t = 0; t < threads; t++)
 	{
-		this->point_size = point_size;
-		cout << symbol << " (Point size " << point_size << " )" << endl;
+		workers[t].join();
+		output += chunks[t];
 	}
-};
 
-// C, D, E, ...
+	return output;
+}
+
 
-// A 'ConcreteFlyweight' class
-class CharacterZ : public Character
+// Builds a document of length characters of which the given percentage has no glyph.
+string MakeDocument(size_t length, int unsupported_percent)
 {
-	public:
+	const char supported[] = "ABZ";
+	const char unsupported[] = "CDRX";
 
-		CharacterZ()
+	string document;
+	unsigned seed = 1;
+
+	for (size_t i = 0; i < length; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		if (static_cast<int>((seed >> 8) % 100) < unsupported_percent)
 		{
-			symbol    = 'Z';
-			width     = 100;
-			height    = 100;
-			ascent    = 68;
-			descent   = 0;
-			point_size = 0; // Initialize
+			document += unsupported[(seed >> 16) % 4];
 		}
+		else
+		{
+			document += supported[(seed >> 16) % 3];
+		}
+	}
 
-	  void Display(int point_size)
-	  {
-		this->point_size = point_size;
-		cout << symbol << " (Point size " << point_size << " )" << endl;
-	  }
-};
-
+	return document;
+}
 
-class MyException : public exception
+// Lays the document out (sums the glyph widths), skipping unsupported characters by catching
+// the exception of GetCharacter() or replacing them through GetCharacterOrReplacement().
+// Returns the time per character in nanoseconds.
+double LayoutTime(CharacterFactory & factory, const string & document, bool replace, long long & total_width)
 {
-	private:
-
-		string s;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
-	public:
+	total_width = 0;
 
-		MyException(string ss) : s(ss) { }
-		~MyException() throw () { } // Updated
-		const char * what() const throw() { return s.c_str(); }
-};
-
-// The 'FlyweightFactory' class
-class CharacterFactory
-{
-	public:
-
-		virtual ~CharacterFactory()
+	for (size_t i = 0; i < document.length(); i++)
+	{
+		if (replace)
 		{
-			while(!characters.empty())
-			{
-				map<char, Character *>::iterator it = characters.begin();
-				delete it->second;
-				characters.erase(it);
-			}
+			total_width += factory.GetCharacterOrReplacement(document[i])->GetWidth();
 		}
-
-		Character * GetCharacter(char key)
+		else
 		{
-			Character * character = NULL;
-
-			if(characters.find(key) != characters.end())
+			try
 			{
-				character = characters[key];
+				total_width += factory.GetCharacter(document[i])->GetWidth();
 			}
-			else
+			catch(MyException &)
 			{
-				switch(key)
-				{
-					case 'A':
-						character = new CharacterA();
-						break;
-
-					case 'B':
-						character = new CharacterB();
-						break;
-
-					// ...
-
-					case 'Z':
-						character = new CharacterZ();
-						break;
-
-					default:
-
-						string msg = "Character ";
-						msg += static_cast<char>(key);
-						msg += " is NOT implemented.";
-						
-						// throw msg;
-						throw MyException(msg);						
-				}
-
-				characters[key] = character;
+				total_width += 110;
 			}
-
-		return character;
+		}
 	}
 
-	private:
+	chrono::duration<double, nano> elapsed = chrono::steady_clock::now() - start;
 
-		map<char, Character *> characters;
-};
+	return elapsed.count() / document.length();
+}
 
 
 //The Main method
@@ -200,7 +158,7 @@ int main()
 	string document = "AAZZBRBZBCDAB";
 	const char * chars = document.c_str();
 
-	Character * character;
+	const Character * character;
 
 	CharacterFactory * factory = new CharacterFactory;
 
@@ -233,9 +191,64 @@ int main()
 		character->Display(point_size++);
 	}
 
+	// The same document without exceptions: unsupported characters show the replacement glyph.
+	cout << endl;
+
+	for(size_t i = 0; i < document.length(); i++)
+	{
+		factory->GetCharacterOrReplacement(chars[i])->Display(point_size++);
+	}
+
 	// Clean memory
 	delete factory;
 
+	// Exceptions versus the replacement glyph on documents with more and more unsupported characters.
+	cout << endl << "unsupported   throw (ns/char)   replace (ns/char)" << endl;
+
+	const int percentages[] = { 0, 10, 50 };
+
+	for (int p = 0; p < 3; p++)
+	{
+		int percent = percentages[p];
+		CharacterFactory bench(true);
+		string text = MakeDocument(200000, percent);
+		long long width_throw, width_replace;
+
+		double throw_time = LayoutTime(bench, text, false, width_throw);
+		double replace_time = LayoutTime(bench, text, true, width_replace);
+
+		cout << percent << "%\t\t" << throw_time << "\t\t" << replace_time
+			 << (width_throw == width_replace ? "" : "   (widths differ!)") << endl;
+	}
+
+	// Rendering a large document on one thread and on every core.
+	CharacterFactory shared(true);
+	string text = MakeDocument(2000000, 10);
+	unsigned cores = thread::hardware_concurrency();
+
+	if (cores == 0)
+	{
+		cores = 1;
+	}
+
+	cout << endl << "rendering " << text.length() << " characters" << endl;
+
+	for (unsigned threads = 1; ; threads = (threads * 2 < cores) ? threads * 2 : cores)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		string output = RenderParallel(shared, text, 10, threads);
+
+		chrono::duration<double, milli> elapsed = chrono::steady_clock::now() - start;
+
+		cout << threads << " thread(s): " << elapsed.count() << " ms, " << output.length() << " bytes of output" << endl;
+
+		if (threads == cores)
+		{
+			break;
+		}
+	}
+
 	cin.get();
 
 	return 0;
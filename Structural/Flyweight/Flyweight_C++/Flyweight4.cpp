@@ -0,0 +1,385 @@
+// Flyweight Design Pattern - Structural Category
+
+// A bounded flyweight cache.
+
+// CharacterFactory in Character.h keeps every flyweight it has ever created until it is destroyed.
+// That is fine for a handful of letters, but a real text renderer shares rasterised glyphs, whose key
+// is (font, point size, code point) and whose bitmaps grow with the point size. Keeping all of them
+// is not an option, so the factory has to become a cache with a memory budget.
+
+// GlyphCache keeps its flyweights within a byte budget and evicts with the CLOCK algorithm, a cheap
+// approximation of least-recently-used: every entry has a reference bit that is set on each hit, and
+// a clock hand sweeps the entries, clearing set bits and evicting the first entry whose bit is clear.
+// Lookups return a GlyphRef, which pins its entry: a pinned glyph is still in use and is never evicted.
+// The cache goes over budget only if every entry is pinned.
+
+// The cache counts hits, misses and evictions, and the bytes saved by sharing: the memory that every
+// lookup would have needed for its own copy of the glyph, minus the memory the cache actually allocated.
+
+// http://en.wikipedia.org/wiki/Page_replacement_algorithm#Clock
+
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <unordered_map>
+
+#include "Character.h"
+
+using namespace std;
+
+// Key of a rasterised glyph.
+struct GlyphKey
+{
+	uint16_t font;
+	uint16_t point_size;
+	char32_t codepoint;
+
+	bool operator==(const GlyphKey & other) const
+	{
+		return font == other.font && point_size == other.point_size && codepoint == other.codepoint;
+	}
+};
+
+struct GlyphKeyHash
+{
+	size_t operator()(const GlyphKey & key) const
+	{
+		uint64_t packed = (static_cast<uint64_t>(key.font) << 48) ^ (static_cast<uint64_t>(key.point_size) << 32) ^ key.codepoint;
+
+		return static_cast<size_t>(packed * 0x9E3779B97F4A7C15ull >> 16);
+	}
+};
+
+// A 'ConcreteFlyweight' class: a glyph rendered in one font at one size.
+// Its bitmap is the intrinsic state that makes sharing worthwhile.
+class RasterCharacter : public Character
+{
+	public:
+
+		RasterCharacter(const GlyphKey & key)
+			: Character(key.codepoint < 0x80 ? static_cast<char>(key.codepoint) : '?', 100, 100, 70, 0),
+			  key(key), bitmap(static_cast<size_t>(key.point_size) * key.point_size, 0)
+		{
+		}
+
+		void Display(int point_size, ostream & out = cout) const
+		{
+			out << "U+" << hex << static_cast<uint32_t>(key.codepoint) << dec << " font " << key.font
+				<< " at " << key.point_size << " pt (Point size " << point_size << " )\n";
+		}
+
+		// Memory held by the flyweight.
+		size_t Bytes() const
+		{
+			return sizeof(*this) + bitmap.capacity();
+		}
+
+	private:
+
+		const GlyphKey key;
+		const vector<unsigned char> bitmap;
+};
+
+class GlyphCache;
+
+// Pins a cached glyph for as long as it exists. Move-only.
+class GlyphRef
+{
+	public:
+
+		GlyphRef() : cache(NULL), slot(0) { }
+
+		GlyphRef(GlyphRef && other) noexcept : cache(other.cache), slot(other.slot)
+		{
+			other.cache = NULL;
+		}
+
+		GlyphRef & operator=(GlyphRef && other) noexcept;
+
+		~GlyphRef();
+
+		const RasterCharacter * operator->() const;
+		const RasterCharacter & operator*() const { return *operator->(); }
+
+	private:
+
+		friend class GlyphCache;
+
+		GlyphRef(GlyphCache * cache, size_t slot) : cache(cache), slot(slot) { }
+
+		GlyphRef(const GlyphRef &); // not allowed
+		GlyphRef & operator=(const GlyphRef &); // not allowed
+
+		GlyphCache * cache;
+		size_t slot;
+};
+
+// The 'FlyweightFactory' class, bounded by a byte budget
+class GlyphCache
+{
+	friend class GlyphRef;
+
+	public:
+
+		GlyphCache(size_t budget) : budget(budget), bytes(0), hand(0),
+			hits(0), misses(0), evictions(0), requestedBytes(0), createdBytes(0)
+		{
+		}
+
+		virtual ~GlyphCache()
+		{
+			for (size_t i = 0; i < entries.size(); i++)
+			{
+				delete entries[i].glyph;
+			}
+		}
+
+		GlyphRef GetCharacter(const GlyphKey & key)
+		{
+			unordered_map<GlyphKey, size_t, GlyphKeyHash>::iterator it = index.find(key);
+			size_t slot;
+
+			if (it != index.end())
+			{
+				slot = it->second;
+				hits++;
+			}
+			else
+			{
+				RasterCharacter * glyph = new RasterCharacter(key);
+
+				misses++;
+				createdBytes += glyph->Bytes();
+
+				slot = Insert(key, glyph);
+			}
+
+			Entry & entry = entries[slot];
+
+			entry.referenced = true;
+			entry.pins++;
+
+			requestedBytes += entry.glyph->Bytes();
+
+			return GlyphRef(this, slot);
+		}
+
+		size_t Bytes() const { return bytes; }
+		size_t Budget() const { return budget; }
+		size_t Entries() const { return index.size(); }
+		uint64_t Hits() const { return hits; }
+		uint64_t Misses() const { return misses; }
+		uint64_t Evictions() const { return evictions; }
+
+		// Memory that a separate copy of the glyph for every lookup would have taken,
+		// minus the memory the cache has allocated.
+		int64_t BytesSaved() const
+		{
+			return static_cast<int64_t>(requestedBytes) - static_cast<int64_t>(createdBytes);
+		}
+
+	private:
+
+		struct Entry
+		{
+			GlyphKey key;
+			RasterCharacter * glyph;	// NULL if the slot is free.
+			size_t bytes;
+			int pins;					// Number of GlyphRefs to the entry.
+			bool referenced;			// Set on every hit, cleared by the clock hand.
+		};
+
+		GlyphCache(const GlyphCache &); // not allowed
+		GlyphCache & operator=(const GlyphCache &); // not allowed
+
+		size_t Insert(const GlyphKey & key, RasterCharacter * glyph)
+		{
+			size_t size = glyph->Bytes();
+
+			while (bytes + size > budget && EvictOne())
+			{
+			}
+
+			size_t slot;
+
+			if (!freeSlots.empty())
+			{
+				slot = freeSlots.back();
+				freeSlots.pop_back();
+			}
+			else
+			{
+				slot = entries.size();
+				entries.push_back(Entry());
+			}
+
+			Entry & entry = entries[slot];
+
+			entry.key = key;
+			entry.glyph = glyph;
+			entry.bytes = size;
+			entry.pins = 0;
+			entry.referenced = false;
+
+			bytes += size;
+			index[key] = slot;
+
+			return slot;
+		}
+
+		// Advances the clock hand to the next unpinned entry whose reference bit is clear and evicts it.
+		// Returns false if every entry is pinned.
+		bool EvictOne()
+		{
+			// Two full turns: the first may only clear reference bits.
+			for (size_t step = 0; step < 2 * entries.size(); step++)
+			{
+				Entry & entry = entries[hand];
+
+				hand = (hand + 1) % entries.size();
+
+				if (entry.glyph == NULL || entry.pins > 0)
+				{
+					continue;
+				}
+
+				if (entry.referenced)
+				{
+					entry.referenced = false;
+					continue;
+				}
+
+				index.erase(entry.key);
+				bytes -= entry.bytes;
+				evictions++;
+
+				delete entry.glyph;
+				entry.glyph = NULL;
+
+				freeSlots.push_back(&entry - &entries[0]);
+
+				return true;
+			}
+
+			return false;
+		}
+
+		void Unpin(size_t slot)
+		{
+			entries[slot].pins--;
+		}
+
+		const size_t budget;
+		size_t bytes;
+		size_t hand;
+
+		vector<Entry> entries;
+		vector<size_t> freeSlots;
+		unordered_map<GlyphKey, size_t, GlyphKeyHash> index;
+
+		uint64_t hits;
+		uint64_t misses;
+		uint64_t evictions;
+		uint64_t requestedBytes;
+		uint64_t createdBytes;
+};
+
+GlyphRef & GlyphRef::operator=(GlyphRef && other) noexcept
+{
+	if (this != &other)
+	{
+		if (cache != NULL)
+		{
+			cache->Unpin(slot);
+		}
+
+		cache = other.cache;
+		slot = other.slot;
+		other.cache = NULL;
+	}
+
+	return *this;
+}
+
+GlyphRef::~GlyphRef()
+{
+	if (cache != NULL)
+	{
+		cache->Unpin(slot);
+	}
+}
+
+const RasterCharacter * GlyphRef::operator->() const
+{
+	return cache->entries[slot].glyph;
+}
+
+
+void Report(const GlyphCache & cache)
+{
+	cout << "entries " << cache.Entries() << ", " << cache.Bytes() / 1024 << " of " << cache.Budget() / 1024 << " KB"
+		 << ", hits " << cache.Hits() << ", misses " << cache.Misses() << ", evictions " << cache.Evictions()
+		 << ", saved " << cache.BytesSaved() / 1024 << " KB" << endl;
+}
+
+
+int main()
+{
+	GlyphCache cache(512 * 1024);
+
+	// A heading stays on screen: its glyphs are pinned while the body text streams by.
+	vector<GlyphRef> heading;
+	const char title[] = "ABBA";
+
+	for (int i = 0; title[i] != '\0'; i++)
+	{
+		GlyphKey key = { 1, 48, static_cast<char32_t>(title[i]) };
+
+		heading.push_back(cache.GetCharacter(key));
+	}
+
+	for (size_t i = 0; i < heading.size(); i++)
+	{
+		heading[i]->Display(static_cast<int>(i));
+	}
+
+	// Body text in 3 fonts and 4 sizes. Most characters come from a small set of frequent ones,
+	// the rest from a few thousand code points.
+	const uint16_t sizes[] = { 9, 10, 12, 14 };
+	unsigned seed = 7;
+
+	for (int i = 0; i < 1000000; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		unsigned r = seed >> 8;
+		char32_t codepoint = (r % 10 < 8) ? 0x41 + r / 10 % 26 : 0x4E00 + r / 10 % 3000;
+		GlyphKey key = { static_cast<uint16_t>(r / 100000 % 3), sizes[r / 1000 % 4], codepoint };
+
+		GlyphRef glyph = cache.GetCharacter(key);
+	}
+
+	Report(cache);
+
+	// The pinned heading survived every eviction.
+	GlyphKey key = { 1, 48, 'A' };
+	uint64_t misses = cache.Misses();
+
+	cache.GetCharacter(key);
+
+	cout << "heading glyph " << (cache.Misses() == misses ? "still cached" : "was evicted") << endl;
+
+	cin.get();
+
+	return 0;
+}
+
+// Output:
+/*
+U+41 font 1 at 48 pt (Point size 0 )
+U+42 font 1 at 48 pt (Point size 1 )
+U+42 font 1 at 48 pt (Point size 2 )
+U+41 font 1 at 48 pt (Point size 3 )
+entries 2675, 511 of 512 KB, hits 827698, misses 172306, evictions 169631, saved 156975 KB
+heading glyph still cached
+*/
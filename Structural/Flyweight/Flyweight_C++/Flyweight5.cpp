@@ -0,0 +1,197 @@
+// Flyweight Design Pattern - Structural Category
+
+// Interning strings and small value objects with the generic Flyweight of Flyweight.h.
+
+// Flyweight1.cpp shares Character objects through a factory written by hand for them. Data models
+// are full of the same kind of repetition - tag names, country codes, styles - and Flyweight<T, Key, Hash>
+// deduplicates any of them: every record keeps a pointer to the one shared value instead of a copy.
+
+// The benchmark below loads a CSV-like log of 2,000,000 records whose text fields come from a small
+// vocabulary, once into plain std::strings and once into interned strings, and compares the memory
+// footprint of the two. The fields are looked up as std::string_views into the input, so a field that
+// has been seen before costs a hash and a comparison but no allocation. It then does the same for a
+// small Style value object.
+
+// http://en.wikipedia.org/wiki/String_interning
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include <functional>
+#include <string_view>
+
+#include "Flyweight.h"
+
+using namespace std;
+
+// Heap memory a string holds beyond its own object; short strings are stored inline.
+size_t HeapBytes(const string & s)
+{
+	string empty;
+
+	return (s.capacity() > empty.capacity()) ? s.capacity() + 1 : 0;
+}
+
+// A value object of the data model.
+struct Style
+{
+	uint32_t font;
+	uint32_t color;
+	float size;
+	float leading;
+	uint32_t flags;
+	uint32_t underline;
+
+	bool operator==(const Style & other) const
+	{
+		return font == other.font && color == other.color && size == other.size && leading == other.leading
+			&& flags == other.flags && underline == other.underline;
+	}
+};
+
+struct StyleHash
+{
+	size_t operator()(const Style & style) const
+	{
+		size_t h = style.font;
+
+		h = h * 31 + style.color;
+		h = h * 31 + hash<float>()(style.size);
+		h = h * 31 + hash<float>()(style.leading);
+		h = h * 31 + style.flags;
+		h = h * 31 + style.underline;
+
+		return h * 0x9E3779B97F4A7C15ull;
+	}
+};
+
+// A log line: "<service>,<region>,<status>\n" with names from a small vocabulary.
+string MakeLog(size_t records)
+{
+	string log;
+	unsigned seed = 2024;
+
+	for (size_t i = 0; i < records; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		unsigned r = seed >> 8;
+
+		log += "payment-gateway-service-" + to_string(r % 500);
+		log += ",datacenter-region-eu-west-" + to_string(r / 500 % 20);
+		log += (r / 10000 % 10 == 0) ? ",status-timeout-after-retry\n" : ",status-completed-successfully\n";
+	}
+
+	return log;
+}
+
+// Calls field(string_view) for every field of the log.
+template <class Field>
+void ForEachField(string_view log, Field field)
+{
+	size_t start = 0;
+
+	for (size_t i = 0; i < log.length(); i++)
+	{
+		if (log[i] == ',' || log[i] == '\n')
+		{
+			field(log.substr(start, i - start));
+			start = i + 1;
+		}
+	}
+}
+
+
+int main()
+{
+	// The same value is interned once, so equal values share one address.
+	Flyweight<string, string_view> names;
+
+	const string & a = names.intern("Flyweight");
+	const string & b = names.intern(string("Fly") + "weight");
+	const string & c = names.intern("Composite");
+
+	cout << a << " [" << &a << "], " << b << " [" << &b << "], " << c << " [" << &c << "]" << endl;
+	cout << "distinct names: " << names.size() << endl << endl;
+
+	// Strings.
+	const size_t records = 2000000;
+	string log = MakeLog(records);
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	vector<string> plain;
+	ForEachField(log, [&plain](string_view field) { plain.push_back(string(field)); });
+
+	chrono::duration<double, milli> plain_time = chrono::steady_clock::now() - start;
+
+	size_t plain_bytes = plain.capacity() * sizeof(string);
+
+	for (size_t i = 0; i < plain.size(); i++)
+	{
+		plain_bytes += HeapBytes(plain[i]);
+	}
+
+	start = chrono::steady_clock::now();
+
+	Flyweight<string, string_view> strings;
+	vector<const string *> interned;
+	ForEachField(log, [&](string_view field) { interned.push_back(&strings.intern(field)); });
+
+	chrono::duration<double, milli> intern_time = chrono::steady_clock::now() - start;
+
+	size_t interned_bytes = interned.capacity() * sizeof(const string *) + strings.bytes();
+
+	for (size_t i = 0; i < plain.size(); i++)
+	{
+		if (strings.find(plain[i]) != interned[i])
+		{
+			cout << "mismatch at field " << i << endl;
+		}
+	}
+
+	cout << interned.size() << " string fields, " << strings.size() << " distinct" << endl;
+	cout << "std::string: " << plain_bytes / (1024 * 1024) << " MB, " << plain_time.count() << " ms to load" << endl;
+	cout << "interned:    " << interned_bytes / (1024 * 1024) << " MB, " << intern_time.count() << " ms to load" << endl;
+
+	// Small value objects.
+	vector<Style> plain_styles;
+	Flyweight<Style, Style, StyleHash> styles;
+	vector<const Style *> interned_styles;
+	unsigned seed = 99;
+
+	for (size_t i = 0; i < records; i++)
+	{
+		seed = seed * 1103515245u + 12345u;
+
+		unsigned r = seed >> 8;
+		Style style = { r % 8, 0xFF000000u | (r / 8 % 16), 9.0f + r / 128 % 6, 1.2f, r / 1024 % 4, 0 };
+
+		plain_styles.push_back(style);
+		interned_styles.push_back(&styles.intern(style));
+	}
+
+	cout << endl << records << " styles, " << styles.size() << " distinct" << endl;
+	cout << "by value:    " << plain_styles.capacity() * sizeof(Style) / 1024 << " KB" << endl;
+	cout << "interned:    " << (interned_styles.capacity() * sizeof(const Style *) + styles.bytes()) / 1024 << " KB" << endl;
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the addresses and timings will vary):
+/*
+Flyweight [0x56433a62cfc0], Flyweight [0x56433a62cfc0], Composite [0x56433a62cfe0]
+distinct names: 2
+
+6000000 string fields, 522 distinct
+std::string: 419 MB, 605.776 ms to load
+interned:    64 MB, 451.397 ms to load
+
+2000000 styles, 3072 distinct
+by value:    49152 KB
+interned:    16520 KB
+*/
@@ -0,0 +1,414 @@
+// Flyweight Design Pattern - Structural Category
+
+// Rendering a document of any size as a stream.
+
+// Flyweight1.cpp renders a document held in a std::string, one Display() call per character, and
+// until now every call ended with endl, so the output was flushed - one system call - per character.
+// That is fine for a sample line but not for a file of gigabytes.
+
+// StreamRenderer renders a file through a fixed amount of memory:
+// - MappedFile maps the input into memory instead of reading it into a string. The renderer walks it
+//   in chunks of 1 MB and tells the kernel to drop every chunk it is done with, so the resident part
+//   of the file stays one chunk whatever the size of the document.
+// - Each chunk is rendered in batches of 4096 characters. A batch is first resolved into an array of
+//   flyweights, then formatted: every flyweight appends its own text, at the point size the caller gives
+//   for its position, to a reusable string with Character::AppendTo(), which renders exactly what
+//   Display() would. The array of a batch takes 32 KB and stays in the cache, where one for a whole
+//   chunk would take 8 MB.
+// - BufferedWriter collects the output in a 1 MB buffer and writes it with one system call when it is full.
+//   OutputFile closes the file it writes to on every path out of the renderer, an exception included.
+
+// Run it as Flyweight7 <input file> [<output file>]. Without arguments it renders a generated document
+// of 256 MB to /dev/null.
+
+// http://man7.org/linux/man-pages/man2/mmap.2.html
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "Character.h"
+
+using namespace std;
+
+// A read-only memory mapping of a whole file.
+class MappedFile
+{
+	public:
+
+		MappedFile(const char * path) : data(NULL), size(0)
+		{
+			int fd = open(path, O_RDONLY);
+
+			if (fd < 0)
+			{
+				throw MyException(string("cannot open ") + path);
+			}
+
+			struct stat info;
+
+			if (fstat(fd, &info) != 0)
+			{
+				close(fd);
+				throw MyException(string("cannot stat ") + path);
+			}
+
+			size = static_cast<size_t>(info.st_size);
+
+			if (size > 0)
+			{
+				void * p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+				if (p == MAP_FAILED)
+				{
+					close(fd);
+					throw MyException(string("cannot map ") + path);
+				}
+
+				data = static_cast<const char *>(p);
+
+				// The file is read once, front to back.
+				madvise(p, size, MADV_SEQUENTIAL);
+			}
+
+			close(fd);
+		}
+
+		~MappedFile()
+		{
+			if (data != NULL)
+			{
+				munmap(const_cast<char *>(data), size);
+			}
+		}
+
+		const char * Data() const { return data; }
+		size_t Size() const { return size; }
+
+		// Lets the kernel reclaim the pages of [offset, offset + length), which will not be read again.
+		// offset must be a multiple of the page size.
+		void Drop(size_t offset, size_t length)
+		{
+			madvise(const_cast<char *>(data) + offset, length, MADV_DONTNEED);
+		}
+
+	private:
+
+		MappedFile(const MappedFile &); // not allowed
+		MappedFile & operator=(const MappedFile &); // not allowed
+
+		const char * data;
+		size_t size;
+};
+
+// A file opened for writing, truncated if it exists, and closed with the object.
+class OutputFile
+{
+	public:
+
+		OutputFile(const char * path) : fd(open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644))
+		{
+			if (fd < 0)
+			{
+				throw MyException(string("cannot open ") + path);
+			}
+		}
+
+		~OutputFile()
+		{
+			close(fd);
+		}
+
+		int Descriptor() const { return fd; }
+
+	private:
+
+		OutputFile(const OutputFile &); // not allowed
+		OutputFile & operator=(const OutputFile &); // not allowed
+
+		const int fd;
+};
+
+// Writes to a file descriptor through a fixed buffer, one system call per buffer.
+class BufferedWriter
+{
+	public:
+
+		static const size_t Capacity = 1 << 20;
+
+		BufferedWriter(int fd) : fd(fd), buffer(new char[Capacity]), used(0), written(0)
+		{
+		}
+
+		// Call Flush() before to see write errors; the destructor cannot report them.
+		~BufferedWriter()
+		{
+			try
+			{
+				Flush();
+			}
+			catch (MyException &)
+			{
+			}
+
+			delete [] buffer;
+		}
+
+		void Write(const char * text, size_t length)
+		{
+			if (used + length > Capacity)
+			{
+				Flush();
+
+				if (length > Capacity)
+				{
+					WriteAll(text, length);
+					return;
+				}
+			}
+
+			memcpy(buffer + used, text, length);
+			used += length;
+		}
+
+		void Write(char c)
+		{
+			if (used == Capacity)
+			{
+				Flush();
+			}
+
+			buffer[used++] = c;
+		}
+
+		void Flush()
+		{
+			WriteAll(buffer, used);
+			used = 0;
+		}
+
+		// Bytes handed to the file descriptor so far.
+		size_t Written() const
+		{
+			return written;
+		}
+
+	private:
+
+		BufferedWriter(const BufferedWriter &); // not allowed
+		BufferedWriter & operator=(const BufferedWriter &); // not allowed
+
+		void WriteAll(const char * text, size_t length)
+		{
+			while (length > 0)
+			{
+				ssize_t n = write(fd, text, length);
+
+				if (n < 0)
+				{
+					// Interrupted by a signal before anything was written: try again.
+					if (errno == EINTR)
+					{
+						continue;
+					}
+
+					throw MyException("write failed");
+				}
+
+				text += n;
+				length -= static_cast<size_t>(n);
+				written += static_cast<size_t>(n);
+			}
+		}
+
+		const int fd;
+		char * const buffer;
+		size_t used;
+		size_t written;
+};
+
+// Renders a mapped document with the flyweights of a factory.
+class StreamRenderer
+{
+	public:
+
+		static const size_t ChunkSize = 1 << 20;
+
+		// The characters of a chunk are resolved and formatted this many at a time.
+		static const size_t BatchSize = 4096;
+
+		// The formatted text is handed to the writer in pieces of about this size.
+		static const size_t TextSize = 64 * 1024;
+
+		StreamRenderer(CharacterFactory & factory) : factory(factory)
+		{
+		}
+
+		// The character at offset i of the document is rendered as Character::Display() would render
+		// it at point_size(i).
+		template <class PointSize>
+		void Render(MappedFile & document, PointSize point_size, BufferedWriter & out)
+		{
+			vector<const Character *> glyphs(BatchSize);
+			string text;
+
+			for (size_t offset = 0; offset < document.Size(); offset += ChunkSize)
+			{
+				size_t length = (document.Size() - offset < ChunkSize) ? document.Size() - offset : ChunkSize;
+				const char * input = document.Data() + offset;
+
+				for (size_t batch = 0; batch < length; batch += BatchSize)
+				{
+					size_t count = (length - batch < BatchSize) ? length - batch : BatchSize;
+
+					// Resolve the batch first: a tight loop of table lookups.
+					for (size_t i = 0; i < count; i++)
+					{
+						glyphs[i] = factory.GetCharacterOrReplacement(input[batch + i]);
+					}
+
+					for (size_t i = 0; i < count; i++)
+					{
+						glyphs[i]->AppendTo(text, point_size(offset + batch + i));
+
+						if (text.length() >= TextSize)
+						{
+							out.Write(text.data(), text.length());
+							text.clear();
+						}
+					}
+				}
+
+				out.Write(text.data(), text.length());
+				text.clear();
+
+				document.Drop(offset, length);
+			}
+		}
+
+	private:
+
+		CharacterFactory & factory;
+};
+
+
+// Peak resident memory of the process, in MB.
+long PeakMemory()
+{
+	struct rusage usage;
+
+	getrusage(RUSAGE_SELF, &usage);
+
+	return usage.ru_maxrss / 1024;
+}
+
+void MakeDocument(const char * path, size_t size)
+{
+	ofstream file(path, ios::binary);
+	string paragraph;
+
+	for (int i = 0; i < 1000; i++)
+	{
+		paragraph += "ABBA ZZ BAZAAR BAZ AB ZABBA\n"[i % 28];
+	}
+
+	for (size_t written = 0; written < size; written += paragraph.length())
+	{
+		file << paragraph;
+	}
+}
+
+
+int main(int argc, char * argv[])
+{
+	CharacterFactory factory(true);
+
+	string input = (argc > 1) ? argv[1] : "/tmp/flyweight_document.txt";
+	const char * output = (argc > 2) ? argv[2] : "/dev/null";
+
+	if (argc <= 1)
+	{
+		MakeDocument(input.c_str(), 256 * 1024 * 1024);
+	}
+
+	// Point size of the character at offset i, as for a document whose size changes along the text.
+	auto point_size = [](size_t i) { return 8 + static_cast<int>(i % 64); };
+
+	try
+	{
+		// The old way for comparison, on the first 4 MB only: Display() and a flush per character.
+		{
+			MappedFile document(input.c_str());
+			size_t length = min(static_cast<size_t>(4 * 1024 * 1024), document.Size());
+			ofstream out(output);
+
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+			for (size_t i = 0; i < length; i++)
+			{
+				factory.GetCharacterOrReplacement(document.Data()[i])->Display(point_size(i), out);
+				out.flush();
+			}
+
+			chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+			cout << "Display() + flush per character: " << length / elapsed.count() / (1024 * 1024) << " MB/s" << endl;
+		}
+
+		MappedFile document(input.c_str());
+
+		OutputFile file(output);
+		size_t written;
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+		{
+			BufferedWriter out(file.Descriptor());
+			StreamRenderer renderer(factory);
+
+			renderer.Render(document, point_size, out);
+
+			out.Flush();
+			written = out.Written();
+		}
+
+		chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+
+		cout << "streaming renderer: " << document.Size() / (1024 * 1024) << " MB in, " << written / (1024 * 1024) << " MB out, "
+			 << document.Size() / elapsed.count() / (1024 * 1024) << " MB/s" << endl;
+	}
+	catch (MyException & e)
+	{
+		cout << e.what() << endl;
+	}
+
+	cout << "peak resident memory: " << PeakMemory() << " MB" << endl;
+
+	if (argc <= 1)
+	{
+		remove(input.c_str());
+	}
+
+	cin.get();
+
+	return 0;
+}
+
+// Output (the throughput will vary):
+/*
+Display() + flush per character: 4.01093 MB/s
+streaming renderer: 256 MB in, 4856 MB out, 57.2637 MB/s
+peak resident memory: 7 MB
+*/